@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cosort.hpp"
+
+using namespace std;
+using namespace stl_ext;
+
+/*
+ * Throughput of cosort in elements per second for several key types, key
+ * distributions, payload sizes and problem sizes, compared with sorting
+ * the same data as a vector of pairs.
+ *
+ * Usage: bench [min_n [max_n]]
+ */
+
+template <size_t N>
+struct payload
+{
+    uint32_t id;
+    char pad[N-sizeof(uint32_t)];
+};
+
+template <>
+struct payload<sizeof(uint32_t)>
+{
+    uint32_t id;
+};
+
+enum distribution { RANDOM, SORTED, REVERSED, FEW_UNIQUE };
+
+const char* distribution_names[] = {"random", "sorted", "reversed", "few-unique"};
+
+/*
+ * Skip problems which would need more than this much memory.
+ */
+const size_t max_bytes = size_t(4) << 30;
+
+template <typename Key>
+vector<Key> make_keys(size_t n, distribution dist)
+{
+    mt19937_64 gen(n);
+    vector<Key> keys(n);
+
+    for (size_t i = 0;i < n;i++)
+    {
+        switch (dist)
+        {
+            case RANDOM:     keys[i] = Key(gen() >> 1); break;
+            case SORTED:     keys[i] = Key(i); break;
+            case REVERSED:   keys[i] = Key(n-i); break;
+            case FEW_UNIQUE: keys[i] = Key(gen()%16); break;
+        }
+    }
+
+    return keys;
+}
+
+/*
+ * Best time over enough repetitions to cover about 0.2 seconds, excluding
+ * the time taken by reset() to restore the input between repetitions.
+ */
+template <typename Reset, typename Func>
+double time_it(Reset&& reset, Func&& func)
+{
+    double best = 1e100;
+    double total = 0;
+
+    for (int rep = 0;rep < 100 && (rep < 3 || total < 0.2);rep++)
+    {
+        reset();
+        auto start = chrono::steady_clock::now();
+        func();
+        double t = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        best = min(best, t);
+        total += t;
+    }
+
+    return best;
+}
+
+template <typename Key, size_t N>
+void bench(const char* key_name, distribution dist, size_t n)
+{
+    typedef payload<N> value;
+
+    if (n*(sizeof(Key)+N)*4 > max_bytes)
+    {
+        printf("%-9s %-11s %5zu %10zu %12s\n", key_name,
+               distribution_names[dist], N, n, "skipped");
+        return;
+    }
+
+    vector<Key> keys0 = make_keys<Key>(n, dist);
+    vector<Key> keys;
+    vector<value> vals(n);
+    vector<pair<Key,value>> pairs;
+
+    auto reset = [&]
+    {
+        keys = keys0;
+        for (size_t i = 0;i < n;i++) vals[i].id = i;
+    };
+
+    auto reset_pairs = [&]
+    {
+        pairs.resize(n);
+        for (size_t i = 0;i < n;i++)
+        {
+            pairs[i].first = keys0[i];
+            pairs[i].second.id = i;
+        }
+    };
+
+    double t_cosort = time_it(reset, [&]{ cosort(keys, vals); });
+
+    double t_comp = time_it(reset,
+    [&]
+    {
+        cosort(keys, vals, [](const Key& a, const Key& b) { return a < b; });
+    });
+
+    double t_par = time_it(reset, [&]{ cosort(par, keys, vals); });
+
+    double t_pair = time_it(reset_pairs,
+    [&]
+    {
+        sort(pairs.begin(), pairs.end(),
+        [](const pair<Key,value>& a, const pair<Key,value>& b)
+        {
+            return a.first < b.first;
+        });
+    });
+
+    printf("%-9s %-11s %5zu %10zu %12.2f %12.2f %12.2f %12.2f\n", key_name,
+           distribution_names[dist], N, n, n/t_cosort/1e6, n/t_comp/1e6,
+           n/t_par/1e6, n/t_pair/1e6);
+    fflush(stdout);
+}
+
+template <typename Key, size_t N>
+void bench_sizes(const char* key_name, size_t min_n, size_t max_n)
+{
+    for (size_t n = min_n;n <= max_n;n *= 10)
+    {
+        for (auto dist : {RANDOM, SORTED, REVERSED, FEW_UNIQUE})
+            bench<Key,N>(key_name, dist, n);
+    }
+}
+
+template <typename Key>
+void bench_key(const char* key_name, size_t min_n, size_t max_n)
+{
+    bench_sizes<Key,4>(key_name, min_n, max_n);
+    bench_sizes<Key,16>(key_name, min_n, max_n);
+    bench_sizes<Key,64>(key_name, min_n, max_n);
+}
+
+int main(int argc, char** argv)
+{
+    size_t min_n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000;
+    size_t max_n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000000;
+
+    printf("Throughput in millions of elements per second\n");
+    printf("%-9s %-11s %5s %10s %12s %12s %12s %12s\n", "key", "dist",
+           "value", "n", "cosort", "cosort(cmp)", "cosort(par)", "pair sort");
+
+    bench_key<int32_t>("int32_t", min_n, max_n);
+    bench_key<uint64_t>("uint64_t", min_n, max_n);
+    bench_key<double>("double", min_n, max_n);
+}
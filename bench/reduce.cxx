@@ -0,0 +1,239 @@
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "algorithm.hpp"
+
+using namespace std;
+using namespace stl_ext;
+
+/*
+ * Throughput of the vectorized reductions in algorithm.hpp in elements per
+ * second, compared with the equivalent single-accumulator loops.
+ *
+ * Usage: bench_reduce [min_n [max_n]]
+ */
+
+/*
+ * Keep the optimizer from discarding results.
+ */
+volatile char sink;
+
+template <typename T>
+void consume(const T& x)
+{
+    sink = *reinterpret_cast<const volatile char*>(&x);
+}
+
+template <typename Func>
+double time_it(Func&& func)
+{
+    double best = 1e100;
+    double total = 0;
+
+    for (int rep = 0;rep < 1000 && (rep < 3 || total < 0.2);rep++)
+    {
+        auto start = chrono::steady_clock::now();
+        func();
+        double t = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        best = min(best, t);
+        total += t;
+    }
+
+    return best;
+}
+
+template <typename U>
+U loop_sum(const vector<U>& v)
+{
+    U s = U();
+    for (auto&& i : v) s += i;
+    return s;
+}
+
+template <typename U>
+U loop_prod(const vector<U>& v)
+{
+    U s = U(1);
+    for (auto&& i : v) s *= i;
+    return s;
+}
+
+template <typename U>
+U loop_max(const vector<U>& v)
+{
+    U m = v[0];
+    for (auto&& i : v) if (m < i) m = i;
+    return m;
+}
+
+template <typename U>
+size_t loop_min_pos(const vector<U>& v)
+{
+    size_t pos = 0;
+    U m = v[0];
+    for (size_t j = 0;j < v.size();j++)
+    {
+        if (v[j] < m)
+        {
+            m = v[j];
+            pos = j;
+        }
+    }
+    return pos;
+}
+
+void report(const char* type, const char* op, size_t n, double t_loop, double t_ext)
+{
+    printf("%-16s %-8s %10zu %12.1f %12.1f %8.2f\n", type, op, n,
+           n/t_loop/1e6, n/t_ext/1e6, t_loop/t_ext);
+    fflush(stdout);
+}
+
+template <typename U>
+vector<U> make_data(size_t n)
+{
+    mt19937_64 gen(n);
+    uniform_real_distribution<double> dist(0.999, 1.001);
+    vector<U> v(n);
+    for (auto& x : v) x = U(dist(gen)*(is_integral<U>::value ? 1000 : 1));
+    return v;
+}
+
+template <typename U>
+void bench_ordered(const char* type, size_t n)
+{
+    auto v = make_data<U>(n);
+
+    report(type, "sum", n, time_it([&]{ consume(loop_sum(v)); }),
+                           time_it([&]{ consume(sum(v)); }));
+    report(type, "prod", n, time_it([&]{ consume(loop_prod(v)); }),
+                            time_it([&]{ consume(prod(v)); }));
+    report(type, "max", n, time_it([&]{ consume(loop_max(v)); }),
+                           time_it([&]{ consume(max(v)); }));
+    report(type, "min_pos", n, time_it([&]{ consume(loop_min_pos(v)); }),
+                               time_it([&]{ consume(min_pos(v)); }));
+}
+
+template <typename U>
+void bench_complex(const char* type, size_t n)
+{
+    auto re = make_data<U>(n);
+    vector<complex<U>> v(n);
+    for (size_t i = 0;i < n;i++) v[i] = {re[i], re[n-1-i]};
+
+    report(type, "sum", n, time_it([&]{ consume(loop_sum(v)); }),
+                           time_it([&]{ consume(sum(v)); }));
+    report(type, "prod", n, time_it([&]{ consume(loop_prod(v)); }),
+                            time_it([&]{ consume(prod(v)); }));
+}
+
+/*
+ * Throughput and relative error of the summation policies, against a sum
+ * in long double of values spread over several orders of magnitude.
+ */
+template <typename U>
+void bench_summation(const char* type, size_t n)
+{
+    mt19937_64 gen(n);
+    uniform_real_distribution<double> dist(-1, 1);
+    vector<U> v(n);
+    long double exact = 0;
+    for (auto& x : v)
+    {
+        x = U(dist(gen)*pow(10.0, 4*dist(gen)))+U(1e3);
+        exact += x;
+    }
+
+    auto error = [&](U s) { return double(fabsl((s-exact)/exact)); };
+
+    U r = sum(v);
+    double t = time_it([&]{ consume(sum(v)); });
+    printf("%-16s %-8s %10zu %12.1f %12.3g\n", type, "plain", n, n/t/1e6, error(r));
+
+    r = sum(pairwise, v);
+    t = time_it([&]{ consume(sum(pairwise, v)); });
+    printf("%-16s %-8s %10zu %12.1f %12.3g\n", type, "pairwise", n, n/t/1e6, error(r));
+
+    r = sum(kahan, v);
+    t = time_it([&]{ consume(sum(kahan, v)); });
+    printf("%-16s %-8s %10zu %12.1f %12.3g\n", type, "kahan", n, n/t/1e6, error(r));
+
+    r = sum(blocked, v);
+    t = time_it([&]{ consume(sum(blocked, v)); });
+    printf("%-16s %-8s %10zu %12.1f %12.3g\n", type, "blocked", n, n/t/1e6, error(r));
+
+    fflush(stdout);
+}
+
+/*
+ * Throughput of prefix_sum, serial and parallel, against a plain loop.
+ */
+template <typename U>
+void bench_scan(const char* type, size_t n)
+{
+    auto v = make_data<U>(n);
+    vector<U> out(n);
+
+    double t_loop = time_it(
+    [&]
+    {
+        U s = U();
+        out[0] = s;
+        for (size_t i = 1;i < n;i++) out[i] = s = s+v[i];
+        consume(out[n-1]);
+    });
+
+    double t_serial = time_it([&]{ consume(*(prefix_sum(v.begin(), v.end(), out.begin(), U())-1)); });
+    double t_par = time_it([&]{ consume(*(prefix_sum(par, v.begin(), v.end(), out.begin(), U())-1)); });
+
+    printf("%-16s %10zu %12.1f %12.1f %12.1f\n", type, n, n/t_loop/1e6,
+           n/t_serial/1e6, n/t_par/1e6);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    size_t min_n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000;
+    size_t max_n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000000;
+
+    printf("Throughput in millions of elements per second\n");
+    printf("%-16s %-8s %10s %12s %12s %8s\n", "type", "op", "n", "loop",
+           "stl_ext", "speedup");
+
+    for (size_t n = min_n;n <= max_n;n *= 10)
+    {
+        bench_ordered<float>("float", n);
+        bench_ordered<double>("double", n);
+        bench_ordered<int32_t>("int32_t", n);
+        bench_ordered<int64_t>("int64_t", n);
+        bench_complex<double>("complex<double>", n);
+    }
+
+    printf("\nSummation policies: throughput in millions of elements per second\n");
+    printf("%-16s %-8s %10s %12s %12s\n", "type", "policy", "n", "stl_ext",
+           "rel. error");
+
+    for (size_t n = min_n;n <= max_n;n *= 10)
+    {
+        bench_summation<float>("float", n);
+        bench_summation<double>("double", n);
+    }
+
+    printf("\nprefix_sum: throughput in millions of elements per second\n");
+    printf("%-16s %10s %12s %12s %12s\n", "type", "n", "loop", "serial",
+           "parallel");
+
+    for (size_t n = min_n;n <= max_n;n *= 10)
+    {
+        bench_scan<int32_t>("int32_t", n);
+        bench_scan<int64_t>("int64_t", n);
+        bench_scan<float>("float", n);
+        bench_scan<double>("double", n);
+    }
+}
@@ -2,17 +2,98 @@
 #define _STL_EXT_ALGORITHM_HPP_
 
 #include <algorithm>
+#include <complex>
+#include <functional>
 #include <iterator>
 #include <vector>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "cosort.hpp"
+#include "simd.hpp"
 #include "type_traits.hpp"
 
 namespace stl_ext
 {
 
+namespace detail
+{
+
+template <typename T, typename=void>
+struct is_hashable : std::false_type {};
+
+template <typename T>
+struct is_hashable<T, enable_if_exists_t<decltype(std::hash<T>()(std::declval<const T&>()))>>
+: std::true_type {};
+
+template <typename T>
+std::unordered_map<typename T::value_type,size_t> count_elements(const T& v)
+{
+    std::unordered_map<typename T::value_type,size_t> counts(v.size());
+    for (auto& e : v) counts[e]++;
+    return counts;
+}
+
+/*
+ * The set operations hash the smaller input instead of sorting both when
+ * the larger one is at least this many times bigger.
+ */
+constexpr size_t hash_set_op_ratio = 8;
+
+template <typename T>
+bool prefer_hash_set_op(const T& v1, const T& v2, std::true_type)
+{
+    return std::min(v1.size(), v2.size())*hash_set_op_ratio <=
+           std::max(v1.size(), v2.size());
+}
+
+template <typename T>
+bool prefer_hash_set_op(const T&, const T&, std::false_type)
+{
+    return false;
+}
+
+template <typename T>
+bool prefer_hash_set_op(const T& v1, const T& v2)
+{
+    return prefer_hash_set_op(v1, v2, is_hashable<typename T::value_type>());
+}
+
+/*
+ * The number of times each element of the smaller of v1 and v2 also
+ * occurs in the larger one (capped at its multiplicity in the smaller),
+ * for elements which occur in both.
+ */
+template <typename T>
+std::unordered_map<typename T::value_type,size_t>
+common_counts(const T& v1, const T& v2)
+{
+    const T& small = v1.size() <= v2.size() ? v1 : v2;
+    const T& large = v1.size() <= v2.size() ? v2 : v1;
+
+    auto avail = count_elements(small);
+    std::unordered_map<typename T::value_type,size_t> common(avail.size());
+
+    for (auto& e : large)
+    {
+        auto it = avail.find(e);
+        if (it != avail.end() && it->second > 0)
+        {
+            it->second--;
+            common[e]++;
+        }
+    }
+
+    return common;
+}
+
+}
+
 template<class Pred1, class Pred2>
 class binary_or
 {
@@ -59,50 +140,55 @@ binary_and<Pred1,Pred2> and1(Pred1 p1, Pred2 p2)
     return binary_and<Pred1,Pred2>(p1,p2);
 }
 
-template <typename T>
-typename T::value_type max(const T& t)
+namespace detail
 {
-    typedef typename T::value_type V;
-    auto i = t.begin();
-    auto e = t.end();
 
-    if (i == e) return V();
+/*
+ * Reductions over contiguous arithmetic or complex elements are split
+ * across vector accumulators; anything else is folded in order.
+ */
+template <typename T>
+using use_simd_reduce = std::integral_constant<bool,
+    is_contiguous<T>::value && is_reorderable<typename T::value_type>::value>;
 
-    V v = *i;
-    for (;i != e;++i) if (v < *i) v = *i;
+template <typename T>
+using use_simd_reduce_pos = std::integral_constant<bool,
+    is_contiguous<T>::value && is_vectorizable<typename T::value_type>::value>;
 
-    return v;
+template <typename T, typename Op>
+typename T::value_type reduce(const T& v, Op op, std::true_type)
+{
+    return reduce(v.data(), v.size(), op);
 }
 
-template <typename T>
-typename T::value_type min(const T& t)
+template <typename T, typename Op>
+typename T::value_type reduce(const T& v, Op op, std::false_type)
 {
-    typedef typename T::value_type V;
-
-    if (t.empty()) return V();
-
-    typename T::const_iterator i = t.begin();
-    V v = *i;
-    for (;i != t.end();++i) if (*i < v) v = *i;
+    auto i = v.begin();
+    typename T::value_type r = *i;
+    for (++i;i != v.end();++i) op(r, *i);
+    return r;
+}
 
-    return v;
+template <typename T, typename Op>
+size_t reduce_pos(const T& v, Op op, std::true_type)
+{
+    return reduce_pos(v.data(), v.size(), op);
 }
 
-template <typename T>
-size_t max_pos(const T& t)
+template <typename T, typename Op>
+size_t reduce_pos(const T& v, Op op, std::false_type)
 {
     typedef typename T::value_type V;
 
-    if (t.empty()) return 0;
-
     size_t pos = 0;
-    typename T::const_iterator i = t.begin();
-    V v = *i;
-    for (size_t j = 0;i != t.end();++i,++j)
+    auto i = v.begin();
+    V r = *i;
+    for (size_t j = 0;i != v.end();++i,++j)
     {
-        if (v < *i)
+        if (op.better(*i, r))
         {
-            v = *i;
+            r = *i;
             pos = j;
         }
     }
@@ -110,527 +196,2974 @@ size_t max_pos(const T& t)
     return pos;
 }
 
+/*
+ * Parallel algorithms split containers with random-access iterators into
+ * chunks; anything else runs serially.
+ */
 template <typename T>
-size_t min_pos(const T& t)
+using is_random_access = std::is_base_of<std::random_access_iterator_tag,
+    typename std::iterator_traits<typename T::const_iterator>::iterator_category>;
+
+template <typename T, typename Op>
+typename T::value_type reduce_range(const T& v, size_t b, size_t e, Op op,
+                                    std::true_type)
 {
-    typedef typename T::value_type V;
+    return reduce(v.data()+b, e-b, op);
+}
 
-    if (t.empty()) return 0;
+template <typename T, typename Op>
+typename T::value_type reduce_range(const T& v, size_t b, size_t e, Op op,
+                                    std::false_type)
+{
+    auto i = v.begin()+b;
+    typename T::value_type r = *i;
+    for (++i;i != v.begin()+e;++i) op(r, *i);
+    return r;
+}
 
-    size_t pos = 0;
-    typename T::const_iterator i = t.begin();
-    V v = *i;
-    for (size_t j = 0;i != t.end();++i,++j)
-    {
-        if (*i < v)
+/*
+ * min and max skip unordered (NaN) elements unless the first one is, so
+ * every chunk but the first is reduced from its first ordered element
+ * (or its last, if it has none, giving a NaN which the combine ignores).
+ */
+template <typename T, typename Op>
+using skip_unordered = std::integral_constant<bool,
+    std::is_floating_point<typename T::value_type>::value &&
+    (std::is_same<Op,min_op>::value || std::is_same<Op,max_op>::value)>;
+
+template <typename T>
+size_t first_ordered(const T& v, size_t b, size_t e, std::true_type)
+{
+    while (b+1 < e && v[b] != v[b]) b++;
+    return b;
+}
+
+template <typename T>
+size_t first_ordered(const T&, size_t b, size_t, std::false_type)
+{
+    return b;
+}
+
+template <typename T, typename Op>
+typename T::value_type reduce(const parallel_policy& policy, const T& v, Op op,
+                              std::true_type)
+{
+    typedef typename T::value_type U;
+    return parallel_reduce<U>(policy, v.size(),
+        [&](size_t b, size_t e)
         {
-            v = *i;
-            pos = j;
-        }
-    }
+            if (b > 0) b = first_ordered(v, b, e, skip_unordered<T,Op>());
+            return reduce_range(v, b, e, op, use_simd_reduce<T>());
+        },
+        [&](U& r, const U& x) { op(r, x); });
+}
 
-    return pos;
+template <typename T, typename Op>
+typename T::value_type reduce(const parallel_policy&, const T& v, Op op,
+                              std::false_type)
+{
+    return reduce(v, op, use_simd_reduce<T>());
 }
 
-template <typename T, typename Functor>
-enable_if_not_same_t<typename T::value_type,Functor,T&>
-erase(T& v, const Functor& f)
+template <typename T, typename Predicate>
+auto count_if(const parallel_policy& policy, const T& v, Predicate& pred,
+              std::true_type)
 {
-    v.erase(std::remove_if(v.begin(), v.end(), f), v.end());
-    return v;
+    typedef decltype(std::count_if(v.begin(), v.end(), pred)) R;
+    if (v.begin() == v.end()) return R();
+    return parallel_reduce<R>(policy, v.size(),
+        [&](size_t b, size_t e) { return std::count_if(v.begin()+b, v.begin()+e, pred); },
+        [](R& r, R x) { r += x; });
+}
+
+template <typename T, typename Predicate>
+auto count_if(const parallel_policy&, const T& v, Predicate& pred,
+              std::false_type)
+{
+    return std::count_if(v.begin(), v.end(), pred);
+}
+
+template <typename T, typename Predicate>
+bool matches(const parallel_policy& policy, const T& v, Predicate& pred,
+             std::true_type)
+{
+    return parallel_any(policy, v.size(),
+        [&](size_t b, size_t e) { return std::any_of(v.begin()+b, v.begin()+e, pred); });
+}
+
+template <typename T, typename Predicate>
+bool matches(const parallel_policy&, const T& v, Predicate& pred,
+             std::false_type)
+{
+    return std::any_of(v.begin(), v.end(), pred);
+}
+
 }
 
 template <typename T>
-T& erase(T& v, const typename T::value_type& e)
+typename T::value_type max(const T& t)
 {
-    v.erase(std::remove(v.begin(), v.end(), e), v.end());
-    return v;
+    if (t.begin() == t.end()) return typename T::value_type();
+    return detail::reduce(t, detail::max_op(), detail::use_simd_reduce<T>());
 }
 
-inline std::string& erase(std::string& v, const std::string& e)
+template <typename T>
+typename T::value_type min(const T& t)
 {
-    for (auto c : e) erase(v, c);
-    return v;
+    if (t.begin() == t.end()) return typename T::value_type();
+    return detail::reduce(t, detail::min_op(), detail::use_simd_reduce<T>());
 }
 
-inline std::string& erase(std::string& v, const char* e)
+/*
+ * Parallel reductions combine the results of fixed-size chunks in order,
+ * so the result does not depend on the number of threads (though for
+ * floating-point values it may differ slightly from the serial one).
+ */
+template <typename T>
+typename T::value_type max(const parallel_policy& policy, const T& t)
 {
-    while (*e) erase(v, *e++);
-    return v;
+    if (t.begin() == t.end()) return typename T::value_type();
+    return detail::reduce(policy, t, detail::max_op(), detail::is_random_access<T>());
 }
 
-template <typename T, typename Functor>
-enable_if_not_same_t<typename T::value_type,Functor,T>
-erased(T v, const Functor& x)
+template <typename T>
+typename T::value_type min(const parallel_policy& policy, const T& t)
 {
-    erase(v, x);
-    return v;
+    if (t.begin() == t.end()) return typename T::value_type();
+    return detail::reduce(policy, t, detail::min_op(), detail::is_random_access<T>());
 }
 
 template <typename T>
-T erased(T v, const typename T::value_type& e)
+size_t max_pos(const T& t)
 {
-    erase(v, e);
-    return v;
+    if (t.begin() == t.end()) return 0;
+    return detail::reduce_pos(t, detail::max_op(), detail::use_simd_reduce_pos<T>());
 }
 
-inline std::string erased(std::string v, const std::string& e)
+template <typename T>
+size_t min_pos(const T& t)
 {
-    erase(v, e);
-    return v;
+    if (t.begin() == t.end()) return 0;
+    return detail::reduce_pos(t, detail::min_op(), detail::use_simd_reduce_pos<T>());
 }
 
-inline std::string erased(std::string v, const char* e)
+/*
+ * A set of characters. erase and filter test the elements of containers of
+ * char against it in a single pass, with vector instructions for strings
+ * and other contiguous containers, however many characters it holds.
+ */
+class char_set
 {
-    erase(v, e);
-    return v;
+    private:
+        detail::byte_set set_;
+
+    public:
+        char_set() {}
+
+        char_set(const char* s)
+        {
+            while (*s) insert(*s++);
+        }
+
+        char_set(const std::string& s)
+        {
+            for (auto c : s) insert(c);
+        }
+
+        void insert(char c) { set_.insert(c); }
+
+        bool contains(char c) const { return set_.contains(c); }
+
+        bool operator()(char c) const { return contains(c); }
+
+        const detail::byte_set& bytes() const { return set_; }
+};
+
+/*
+ * The characters c for which pred(c) holds.
+ */
+template <typename Predicate>
+char_set make_char_set(Predicate pred)
+{
+    char_set s;
+    for (int c = CHAR_MIN;c <= CHAR_MAX;c++)
+        if (pred(char(c))) s.insert(char(c));
+    return s;
 }
 
-template <typename T, class Predicate>
-T& filter(T& v, Predicate pred)
+namespace detail
+{
+
+/*
+ * Containers which filter and mask compact 64 elements at a time with
+ * compress(), from a bit mask of the elements to keep.
+ */
+template <typename T>
+struct use_compress
+: std::integral_constant<bool, is_contiguous<T>::value &&
+                               std::is_trivially_copyable<typename T::value_type>::value> {};
+
+/*
+ * Copy the elements of v selected by sel(p, i, n), the bit mask of the
+ * n <= 64 elements p[0,n) starting at position i, to out, which may be v
+ * itself.
+ */
+template <typename T, typename Selection>
+T& compact(const T& v, T& out, Selection&& sel, std::true_type)
+{
+    size_t n = v.size();
+    if (n == 0)
+    {
+        out.clear();
+        return out;
+    }
+
+    /*
+     * out grows as needed, rather than to n up front, so that reusing a
+     * buffer for a small result does not write all n elements.
+     */
+    auto p = &v[0];
+    size_t k = 0;
+    for (size_t i = 0;i < n;i += 64)
+    {
+        size_t m = std::min<size_t>(64, n-i);
+        if (out.size() < k+m)
+            out.resize(std::min(n, std::max(k+m, 2*out.size())));
+
+        auto q = &out[0];
+        uint64_t keep = sel(p+i, i, m);
+        uint64_t all = m < 64 ? (uint64_t(1) << m)-1 : ~uint64_t(0);
+
+        if ((keep & all) == 0) continue;
+
+        if ((keep & all) == all)
+        {
+            if (q+k != p+i) std::memmove(q+k, p+i, m*sizeof(*p));
+            k += m;
+        }
+        else
+        {
+            k += compress(q+k, p+i, m, keep);
+        }
+    }
+
+    out.resize(k);
+    return out;
+}
+
+template <typename T, typename Selection>
+T& compact(T& v, Selection&& sel, std::true_type)
+{
+    return compact(v, v, sel, std::true_type());
+}
+
+/*
+ * Keep the elements x at positions i for which sel(i, x) holds, moving
+ * each one at most once.
+ */
+template <typename T, typename Selection>
+T& compact(T& v, Selection&& sel, std::false_type)
 {
-    auto i1 = v.begin();
     auto i2 = v.begin();
+    size_t i = 0;
 
-    while (i1 != v.end())
+    for (auto i1 = v.begin();i1 != v.end();++i1, ++i)
     {
-        if (pred(*i1))
+        if (sel(i, *i1))
         {
-            std::iter_swap(i1, i2);
+            if (i1 != i2) *i2 = std::move(*i1);
             ++i2;
         }
-        ++i1;
     }
 
     v.resize(i2-v.begin());
     return v;
 }
 
-template <typename T, class Predicate>
-T filtered(T v, Predicate pred)
+template <typename T, typename Selection>
+T& compact(const T& v, T& out, Selection&& sel, std::false_type)
 {
-    filter(v, pred);
-    return v;
-}
+    if (&v == &out) return compact(out, sel, std::false_type());
 
-template <template <typename...> class T, typename U, class Functor>
-auto apply(const T<U>& v, const Functor& f) -> T<decltype(f(std::declval<U>()))>
-{
-    T<decltype(f(std::declval<U>()))> v2;
-    for (auto& i : v)
+    out.clear();
+    size_t i = 0;
+    for (auto& x : v)
     {
-        v2.push_back(f(i));
+        if (sel(i++, x)) out.push_back(x);
     }
-    return v2;
+
+    return out;
 }
 
-template <class InputIt, class OutputIt, class T>
-OutputIt prefix_sum(InputIt first, InputIt last, OutputIt d_first, T init)
+/*
+ * Selections for compact(), by a predicate which must hold (or not, if
+ * Keep is false) for the elements which are kept, and by membership in a
+ * char_set.
+ */
+template <typename Predicate, bool Keep>
+struct predicate_selection
 {
-    if (first == last) return d_first;
+    Predicate& pred;
 
-    typename std::iterator_traits<InputIt>::value_type sum = init;
-    *d_first = sum;
+    template <typename Pointer>
+    uint64_t operator()(Pointer p, size_t, size_t n) const
+    {
+        /*
+         * A constant trip count lets full blocks vectorize.
+         */
+        uint64_t bits = 0;
+        if (n == 64)
+            for (size_t j = 0;j < 64;j++) bits |= uint64_t(bool(pred(p[j])) == Keep) << j;
+        else
+            for (size_t j = 0;j < n;j++) bits |= uint64_t(bool(pred(p[j])) == Keep) << j;
+        return bits;
+    }
 
-    while (++first != last)
+    template <typename U>
+    bool operator()(size_t, U&& x) const
     {
-       sum = sum + *first;
-       *++d_first = sum;
+        return bool(pred(std::forward<U>(x))) == Keep;
     }
+};
 
-    return ++d_first;
+template <bool Keep, typename Predicate>
+predicate_selection<Predicate,Keep> select_by(Predicate& pred)
+{
+    return {pred};
 }
 
-template <class InputIt, class OutputIt, class T, class BinaryOperation>
-OutputIt prefix_sum(InputIt first, InputIt last, OutputIt d_first, T init,
-                    BinaryOperation op)
+template <bool Keep>
+struct char_selection
 {
-    if (first == last) return d_first;
+    const char_set& set;
 
-    typename std::iterator_traits<InputIt>::value_type sum = init;
-    *d_first = sum;
+    template <typename Pointer>
+    uint64_t operator()(Pointer p, size_t, size_t n) const
+    {
+        uint64_t bits = classify(set.bytes(), reinterpret_cast<const unsigned char*>(p), n);
+        return Keep ? bits : ~bits;
+    }
 
-    while (++first != last)
+    template <typename U>
+    bool operator()(size_t, const U& x) const
     {
-       sum = op(sum, *first);
-       *++d_first = sum;
+        return set.contains(x) == Keep;
     }
+};
+
+template <typename T, typename R=T&>
+using enable_if_chars_t =
+    enable_if_t<std::is_integral<typename T::value_type>::value &&
+                sizeof(typename T::value_type) == 1 &&
+                !std::is_same<typename T::value_type,bool>::value, R>;
 
-    return ++d_first;
 }
 
-template <typename T>
-typename T::value_type sum(const T& v)
+template <typename T, typename Functor>
+enable_if_not_same_t<typename T::value_type,Functor,T&>
+erase(T& v, const Functor& f)
 {
-    typedef typename T::value_type U;
-    U s = U();
-    for (auto&& i : v) s += i;
-    return s;
+    v.erase(std::remove_if(v.begin(), v.end(), f), v.end());
+    return v;
 }
 
 template <typename T>
-typename T::value_type prod(const T& v)
+T& erase(T& v, const typename T::value_type& e)
 {
-    typedef typename T::value_type U;
-    U s = U(1);
-    for (auto&& i : v) s *= i;
-    return s;
+    v.erase(std::remove(v.begin(), v.end(), e), v.end());
+    return v;
 }
 
-template <typename T, typename U>
-auto find(const T& v, const U& e)
+/*
+ * Remove the characters in e.
+ */
+template <typename T>
+detail::enable_if_chars_t<T> erase(T& v, const char_set& e)
 {
-    return std::find(v.begin(), v.end(), e);
+    return detail::compact(v, detail::char_selection<false>{e}, detail::use_compress<T>());
 }
 
-template <typename T, typename Predicate>
-auto find_if(const T& v, Predicate&& pred)
+inline std::string& erase(std::string& v, const std::string& e)
 {
-    return std::find_if(v.begin(), v.end(), std::forward<Predicate>(pred));
+    return erase(v, char_set(e));
 }
 
-template <typename T, typename U>
-auto index_of(const T& v, const U& e)
+inline std::string& erase(std::string& v, const char* e)
 {
-    return find(v, e) - v.begin();
+    return erase(v, char_set(e));
 }
 
-template <typename T, typename Predicate>
-auto index_where(const T& v, Predicate&& pred)
+template <typename T, typename Functor>
+enable_if_not_same_t<typename T::value_type,Functor,T>
+erased(T v, const Functor& x)
 {
-    return find_if(v, std::forward<Predicate>(pred)) - v.begin();
+    erase(v, x);
+    return v;
 }
 
-template <typename T, typename U>
-bool contains(const T& v, const U& e)
+template <typename T>
+T erased(T v, const typename T::value_type& e)
 {
-    return find(v, e) != v.end();
+    erase(v, e);
+    return v;
 }
 
-template <typename T, typename U>
-auto count(const T& v, const U& e)
+template <typename T>
+detail::enable_if_chars_t<T,T> erased(T v, const char_set& e)
 {
-    return std::count(v.begin(), v.end(), e);
+    erase(v, e);
+    return v;
 }
 
-template <typename T, typename Predicate>
-bool matches(const T& v, Predicate&& pred)
+inline std::string erased(std::string v, const std::string& e)
 {
-    return find_if(v, std::forward<Predicate>(pred)) != v.end();
+    erase(v, e);
+    return v;
 }
 
-template <typename T, typename U>
-std::enable_if_t<!std::is_same<U,typename T::value_type>::value,bool>
-starts_with(const T& v1, const U& v2)
+inline std::string erased(std::string v, const char* e)
 {
-    if (v1.size() < v2.size())
+    erase(v, e);
+    return v;
+}
+
+/*
+ * As erased(v, ...), but into the existing container out, reusing its
+ * storage. Only the elements which are kept are copied.
+ */
+template <typename T, typename Functor>
+enable_if_not_same_t<typename T::value_type,Functor,T&>
+erased(const T& v, const Functor& f, T& out)
+{
+    return detail::compact(v, out, detail::select_by<false>(f), detail::use_compress<T>());
+}
+
+template <typename T>
+T& erased(const T& v, const typename T::value_type& e, T& out)
+{
+    auto equal = [&e](const typename T::value_type& x) { return x == e; };
+    return detail::compact(v, out, detail::select_by<false>(equal), detail::use_compress<T>());
+}
+
+template <typename T>
+detail::enable_if_chars_t<T> erased(const T& v, const char_set& e, T& out)
+{
+    return detail::compact(v, out, detail::char_selection<false>{e}, detail::use_compress<T>());
+}
+
+/*
+ * Write the elements of v which are not erased to d_first, and return the
+ * end of the output.
+ */
+template <typename T, typename Functor, typename OutputIt>
+enable_if_not_same_t<typename T::value_type,Functor,OutputIt>
+erase_copy(const T& v, const Functor& f, OutputIt d_first)
+{
+    return std::remove_copy_if(v.begin(), v.end(), d_first, f);
+}
+
+template <typename T, typename OutputIt>
+OutputIt erase_copy(const T& v, const typename T::value_type& e, OutputIt d_first)
+{
+    return std::remove_copy(v.begin(), v.end(), d_first, e);
+}
+
+template <typename T, class Predicate>
+T& filter(T& v, Predicate pred)
+{
+    return detail::compact(v, detail::select_by<true>(pred), detail::use_compress<T>());
+}
+
+template <typename T, class Predicate>
+T filtered(T v, Predicate pred)
+{
+    filter(v, pred);
+    return v;
+}
+
+/*
+ * Keep the characters in s.
+ */
+template <typename T>
+detail::enable_if_chars_t<T> filter(T& v, const char_set& s)
+{
+    return detail::compact(v, detail::char_selection<true>{s}, detail::use_compress<T>());
+}
+
+template <typename T>
+detail::enable_if_chars_t<T,T> filtered(T v, const char_set& s)
+{
+    filter(v, s);
+    return v;
+}
+
+/*
+ * As filtered(v, ...), but into the existing container out, reusing its
+ * storage. Only the elements which are kept are copied.
+ */
+template <typename T, class Predicate>
+T& filtered(const T& v, Predicate pred, T& out)
+{
+    return detail::compact(v, out, detail::select_by<true>(pred), detail::use_compress<T>());
+}
+
+template <typename T>
+detail::enable_if_chars_t<T> filtered(const T& v, const char_set& s, T& out)
+{
+    return detail::compact(v, out, detail::char_selection<true>{s}, detail::use_compress<T>());
+}
+
+/*
+ * Write the elements of v for which pred holds to d_first, and return the
+ * end of the output.
+ */
+template <typename T, class Predicate, typename OutputIt>
+OutputIt filter_copy(const T& v, Predicate pred, OutputIt d_first)
+{
+    return std::copy_if(v.begin(), v.end(), d_first, pred);
+}
+
+template <template <typename...> class T, typename U, typename... Args, class Functor>
+auto apply(const T<U,Args...>& v, const Functor& f) -> T<decltype(f(std::declval<U>()))>
+{
+    T<decltype(f(std::declval<U>()))> v2;
+    for (auto& i : v)
+    {
+        v2.push_back(f(i));
+    }
+    return v2;
+}
+
+namespace detail
+{
+
+/*
+ * Iterators known to point into contiguous storage: pointers and those of
+ * std::vector and std::string.
+ */
+template <typename It, typename V=typename std::iterator_traits<It>::value_type,
+          typename=void>
+struct is_contiguous_iterator : std::is_pointer<It> {};
+
+template <typename It, typename V>
+struct is_contiguous_iterator<It, V, enable_if_t<std::is_object<V>::value &&
+                                                 !std::is_same<V,bool>::value>>
+: std::integral_constant<bool,
+    std::is_pointer<It>::value ||
+    std::is_same<It,typename std::vector<V>::iterator>::value ||
+    std::is_same<It,typename std::vector<V>::const_iterator>::value ||
+    std::is_same<It,std::string::iterator>::value ||
+    std::is_same<It,std::string::const_iterator>::value> {};
+
+template <typename Op, typename V> struct is_plus : std::false_type {};
+template <typename V> struct is_plus<std::plus<V>,V> : std::true_type {};
+template <typename V> struct is_plus<std::plus<void>,V> : std::true_type {};
+
+/*
+ * Scans of arithmetic values with + between contiguous ranges of the same
+ * type run on vectors. Vectors reassociate the additions, so serial scans
+ * only use them for integers, where the result is the same.
+ */
+template <class InputIt, class OutputIt, class BinaryOperation,
+          typename V=typename std::iterator_traits<InputIt>::value_type>
+using use_simd_scan = std::integral_constant<bool,
+    is_contiguous_iterator<InputIt>::value &&
+    is_contiguous_iterator<OutputIt>::value &&
+    std::is_same<V,typename std::iterator_traits<OutputIt>::value_type>::value &&
+    is_vectorizable<V>::value && is_plus<BinaryOperation,V>::value>;
+
+template <class InputIt, class OutputIt, class BinaryOperation,
+          typename V=typename std::iterator_traits<InputIt>::value_type>
+using use_serial_simd_scan = std::integral_constant<bool,
+    use_simd_scan<InputIt,OutputIt,BinaryOperation>::value &&
+    std::is_integral<V>::value>;
+
+/*
+ * acc op *first op ... op *(last-1)
+ */
+template <class InputIt, class V, class BinaryOperation>
+V scan_total(InputIt first, InputIt last, V acc, BinaryOperation& op,
+             std::false_type)
+{
+    for (;first != last;++first) acc = op(acc, *first);
+    return acc;
+}
+
+template <class InputIt, class V, class BinaryOperation>
+V scan_total(InputIt first, InputIt last, V acc, BinaryOperation&,
+             std::true_type)
+{
+    if (first == last) return acc;
+    return acc+reduce(&*first, last-first, plus_op());
+}
+
+/*
+ * d_first[i] = carry op *first op ... op first[i]
+ */
+template <class InputIt, class OutputIt, class V, class BinaryOperation>
+OutputIt scan_carry(InputIt first, InputIt last, OutputIt d_first, V carry,
+                    BinaryOperation& op, std::false_type)
+{
+    for (;first != last;++first,++d_first) *d_first = carry = op(carry, *first);
+    return d_first;
+}
+
+template <class InputIt, class OutputIt, class V, class BinaryOperation>
+OutputIt scan_carry(InputIt first, InputIt last, OutputIt d_first, V carry,
+                    BinaryOperation&, std::true_type)
+{
+    simd_scan(&*first, &*d_first, last-first, carry);
+    return d_first+(last-first);
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation,
+          class Simd>
+OutputIt prefix_sum(InputIt first, InputIt last, OutputIt d_first, T init,
+                    BinaryOperation& op, Simd simd)
+{
+    if (first == last) return d_first;
+
+    typename std::iterator_traits<InputIt>::value_type sum = init;
+    *d_first = sum;
+
+    return scan_carry(++first, last, ++d_first, sum, op, simd);
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt prefix_sum(const parallel_policy& policy, InputIt first, InputIt last,
+                    OutputIt d_first, T init, BinaryOperation& op,
+                    std::false_type)
+{
+    return prefix_sum(first, last, d_first, init, op,
+                      use_serial_simd_scan<InputIt,OutputIt,BinaryOperation>());
+}
+
+/*
+ * Two-pass parallel scan over fixed-size chunks: the chunk totals are
+ * computed in parallel and scanned serially into the carry-in of each
+ * chunk, then the chunks are scanned in parallel.
+ */
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt prefix_sum(const parallel_policy& policy, InputIt first, InputIt last,
+                    OutputIt d_first, T init, BinaryOperation& op,
+                    std::true_type)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    typedef use_simd_scan<InputIt,OutputIt,BinaryOperation> simd;
+
+    size_t n = last-first;
+    size_t chunk = parallel_reduce_chunk;
+    size_t nchunk = (n+chunk-1)/chunk;
+
+    /*
+     * Integer scans come out the same either way, so skip the extra pass
+     * when there is only one thread to run them on.
+     */
+    if (nchunk <= 1 || (std::is_integral<V>::value && policy.num_threads() == 1))
+        return prefix_sum(first, last, d_first, init, op, simd());
+
+    std::vector<V> carry(nchunk);
+
+    parallel_for(policy, nchunk-1, 1,
+    [&](size_t, size_t cfirst, size_t clast)
+    {
+        for (size_t c = cfirst;c < clast;c++)
+        {
+            size_t b = c*chunk;
+            size_t e = b+chunk;
+            carry[c+1] = c == 0 ? scan_total(first+1, first+e, V(init), op, simd())
+                                : scan_total(first+b+1, first+e, V(first[b]), op, simd());
+        }
+    });
+
+    for (size_t c = 2;c < nchunk;c++) carry[c] = op(carry[c-1], carry[c]);
+
+    parallel_for(policy, nchunk, 1,
+    [&](size_t, size_t cfirst, size_t clast)
+    {
+        for (size_t c = cfirst;c < clast;c++)
+        {
+            size_t b = c*chunk;
+            size_t e = std::min(b+chunk, n);
+            if (c == 0)
+            {
+                prefix_sum(first, first+e, d_first, init, op, simd());
+            }
+            else
+            {
+                scan_carry(first+b, first+e, d_first+b, carry[c], op, simd());
+            }
+        }
+    });
+
+    return d_first+n;
+}
+
+}
+
+/*
+ * d_first[0] = init and d_first[i] = d_first[i-1] op first[i] for i > 0.
+ */
+template <class InputIt, class OutputIt, class T>
+OutputIt prefix_sum(InputIt first, InputIt last, OutputIt d_first, T init)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    std::plus<V> op;
+    return detail::prefix_sum(first, last, d_first, init, op,
+        detail::use_serial_simd_scan<InputIt,OutputIt,std::plus<V>>());
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt prefix_sum(InputIt first, InputIt last, OutputIt d_first, T init,
+                    BinaryOperation op)
+{
+    return detail::prefix_sum(first, last, d_first, init, op,
+        detail::use_serial_simd_scan<InputIt,OutputIt,BinaryOperation>());
+}
+
+/*
+ * Parallel scans need random-access iterators and an associative op, and
+ * run serially otherwise. The result does not depend on the number of
+ * threads, and for integers is identical to the serial one.
+ */
+template <class InputIt, class OutputIt, class T>
+OutputIt prefix_sum(const parallel_policy& policy, InputIt first, InputIt last,
+                    OutputIt d_first, T init)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    return prefix_sum(policy, first, last, d_first, init, std::plus<V>());
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt prefix_sum(const parallel_policy& policy, InputIt first, InputIt last,
+                    OutputIt d_first, T init, BinaryOperation op)
+{
+    typedef std::random_access_iterator_tag ra;
+    return detail::prefix_sum(policy, first, last, d_first, init, op,
+        std::integral_constant<bool,
+            std::is_base_of<ra,typename std::iterator_traits<InputIt>::iterator_category>::value &&
+            std::is_base_of<ra,typename std::iterator_traits<OutputIt>::iterator_category>::value>());
+}
+
+namespace detail
+{
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt exclusive_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              T init, BinaryOperation& op, std::false_type)
+{
+    typename std::iterator_traits<InputIt>::value_type sum = init;
+
+    for (;first != last;++first,++d_first)
+    {
+        auto x = *first;
+        *d_first = sum;
+        sum = op(sum, x);
+    }
+
+    return d_first;
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt exclusive_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              T init, BinaryOperation&, std::true_type)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    if (first == last) return d_first;
+    simd_exclusive_scan(&*first, &*d_first, last-first, V(init));
+    return d_first+(last-first);
+}
+
+template <class InputIt, class OutputIt, class Head, class BinaryOperation>
+OutputIt segmented_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              Head& head, BinaryOperation& op, std::false_type)
+{
+    if (first == last) return d_first;
+
+    typename std::iterator_traits<InputIt>::value_type sum = *first;
+    *d_first = sum;
+
+    size_t i = 1;
+    for (++first, ++d_first;first != last;++first,++d_first,++i)
+    {
+        sum = head(i) ? *first : op(sum, *first);
+        *d_first = sum;
+    }
+
+    return d_first;
+}
+
+template <class InputIt, class OutputIt, class Head, class BinaryOperation>
+OutputIt segmented_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              Head& head, BinaryOperation&, std::true_type)
+{
+    if (first == last) return d_first;
+    simd_segmented_scan(&*first, &*d_first, last-first, head);
+    return d_first+(last-first);
+}
+
+/*
+ * Segment heads read from a flag or key sequence. The vector kernels need
+ * random access to it; otherwise it is read once, in order.
+ */
+template <class FlagIt>
+struct flag_heads
+{
+    FlagIt flag;
+
+    bool operator()(size_t i) { return i == 0 || bool(flag[i]); }
+};
+
+template <class FlagIt>
+struct sequential_flag_heads
+{
+    FlagIt flag;
+
+    bool operator()(size_t) { return bool(*++flag); }
+};
+
+template <class KeyIt>
+struct key_heads
+{
+    KeyIt key;
+
+    bool operator()(size_t i) { return i == 0 || !(key[i] == key[i-1]); }
+};
+
+template <class KeyIt>
+struct sequential_key_heads
+{
+    KeyIt key;
+    typename std::iterator_traits<KeyIt>::value_type prev;
+
+    bool operator()(size_t)
+    {
+        bool head = !(*++key == prev);
+        prev = *key;
+        return head;
+    }
+};
+
+template <class KeyIt>
+key_heads<KeyIt> make_key_heads(KeyIt key, std::true_type)
+{
+    return {key};
+}
+
+template <class KeyIt>
+sequential_key_heads<KeyIt> make_key_heads(KeyIt key, std::false_type)
+{
+    return {key, *key};
+}
+
+template <class It>
+using is_random_access_iterator = std::is_base_of<std::random_access_iterator_tag,
+    typename std::iterator_traits<It>::iterator_category>;
+
+template <class InputIt, class OutputIt, class HeadIt, class Head,
+          class BinaryOperation>
+OutputIt segmented_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              Head head, BinaryOperation& op)
+{
+    return segmented_prefix_sum(first, last, d_first, head, op,
+        std::integral_constant<bool,
+            use_serial_simd_scan<InputIt,OutputIt,BinaryOperation>::value &&
+            is_random_access_iterator<HeadIt>::value>());
+}
+
+}
+
+/*
+ * d_first[0] = init and d_first[i] = d_first[i-1] op first[i-1] for i > 0,
+ * e.g. the offsets of consecutive blocks given their sizes.
+ */
+template <class InputIt, class OutputIt, class T>
+OutputIt exclusive_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              T init)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    std::plus<V> op;
+    return detail::exclusive_prefix_sum(first, last, d_first, init, op,
+        detail::use_serial_simd_scan<InputIt,OutputIt,std::plus<V>>());
+}
+
+template <class InputIt, class OutputIt, class T, class BinaryOperation>
+OutputIt exclusive_prefix_sum(InputIt first, InputIt last, OutputIt d_first,
+                              T init, BinaryOperation op)
+{
+    return detail::exclusive_prefix_sum(first, last, d_first, init, op,
+        detail::use_serial_simd_scan<InputIt,OutputIt,BinaryOperation>());
+}
+
+/*
+ * Inclusive scan which restarts at every element whose flag is set: the
+ * flag of the first element is ignored, and d_first[i] = first[i] if
+ * flag_first[i] and d_first[i-1] op first[i] otherwise.
+ */
+template <class InputIt, class FlagIt, class OutputIt, class BinaryOperation>
+OutputIt segmented_prefix_sum(InputIt first, InputIt last, FlagIt flag_first,
+                              OutputIt d_first, BinaryOperation op)
+{
+    typedef conditional_t<detail::is_random_access_iterator<FlagIt>::value,
+                          detail::flag_heads<FlagIt>,
+                          detail::sequential_flag_heads<FlagIt>> heads;
+    return detail::segmented_prefix_sum<InputIt,OutputIt,FlagIt>(
+        first, last, d_first, heads{flag_first}, op);
+}
+
+template <class InputIt, class FlagIt, class OutputIt>
+OutputIt segmented_prefix_sum(InputIt first, InputIt last, FlagIt flag_first,
+                              OutputIt d_first)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    return segmented_prefix_sum(first, last, flag_first, d_first, std::plus<V>());
+}
+
+/*
+ * Inclusive scan which restarts wherever the key changes, i.e. a separate
+ * prefix_sum of every run of equal keys. The keys are compared with ==
+ * and must be at least forward iterators.
+ */
+template <class KeyIt, class InputIt, class OutputIt, class BinaryOperation>
+OutputIt prefix_sum_by_key(KeyIt key_first, KeyIt key_last, InputIt first,
+                           OutputIt d_first, BinaryOperation op)
+{
+    if (key_first == key_last) return d_first;
+
+    auto last = std::next(first, std::distance(key_first, key_last));
+    return detail::segmented_prefix_sum<InputIt,OutputIt,KeyIt>(first, last, d_first,
+        detail::make_key_heads(key_first, detail::is_random_access_iterator<KeyIt>()), op);
+}
+
+template <class KeyIt, class InputIt, class OutputIt>
+OutputIt prefix_sum_by_key(KeyIt key_first, KeyIt key_last, InputIt first,
+                           OutputIt d_first)
+{
+    typedef typename std::iterator_traits<InputIt>::value_type V;
+    return prefix_sum_by_key(key_first, key_last, first, d_first, std::plus<V>());
+}
+
+template <typename T>
+typename T::value_type sum(const T& v)
+{
+    typedef typename T::value_type U;
+    if (v.begin() == v.end()) return U();
+    return detail::reduce(v, detail::plus_op(), detail::use_simd_reduce<T>());
+}
+
+/*
+ * Summation policies for floating-point and complex sums, trading speed
+ * for accuracy differently from the plain sum(v):
+ *
+ *  - sum(pairwise, v) sums halves recursively, the error growing with the
+ *    logarithm of the length,
+ *  - sum(kahan, v) uses Neumaier's compensated summation, with an error
+ *    independent of the length,
+ *  - sum(blocked, v) sums fixed-size blocks directly and accumulates the
+ *    block sums with compensation, at close to the speed of sum(v).
+ *
+ * Containers of other types are summed as by sum(v).
+ */
+struct pairwise_policy {};
+constexpr pairwise_policy pairwise;
+
+struct kahan_policy {};
+constexpr kahan_policy kahan;
+
+struct blocked_policy {};
+constexpr blocked_policy blocked;
+
+namespace detail
+{
+
+template <typename Policy> struct is_summation_policy : std::false_type {};
+template <> struct is_summation_policy<pairwise_policy> : std::true_type {};
+template <> struct is_summation_policy<kahan_policy> : std::true_type {};
+template <> struct is_summation_policy<blocked_policy> : std::true_type {};
+
+/*
+ * Complex numbers are summed as separate real and imaginary parts.
+ */
+template <typename U> struct summation_part { typedef U type; };
+template <typename U> struct summation_part<std::complex<U>> { typedef U type; };
+
+/*
+ * 0: plain sum, 1: compensated sequential sum, 2: vector kernels.
+ */
+template <typename T, typename U=typename T::value_type,
+          typename R=typename summation_part<U>::type>
+using summation_path = std::integral_constant<int,
+    !std::is_floating_point<R>::value ? 0 :
+    is_contiguous<T>::value && is_vectorizable<R>::value ? 2 : 1>;
+
+template <typename R>
+void sum_parts(pairwise_policy, const R* p, size_t n, R* out, size_t nout)
+{
+    simd_sum<pairwise_summation>(p, n, out, nout);
+}
+
+template <typename R>
+void sum_parts(kahan_policy, const R* p, size_t n, R* out, size_t nout)
+{
+    simd_sum<compensated_summation>(p, n, out, nout);
+}
+
+template <typename R>
+void sum_parts(blocked_policy, const R* p, size_t n, R* out, size_t nout)
+{
+    simd_sum<blocked_summation>(p, n, out, nout);
+}
+
+template <typename Policy, typename T>
+typename T::value_type sum(Policy, const T& v, std::integral_constant<int,0>)
+{
+    return stl_ext::sum(v);
+}
+
+template <typename Policy, typename T>
+typename T::value_type sum(Policy, const T& v, std::integral_constant<int,1>)
+{
+    typedef typename T::value_type U;
+    typedef typename summation_part<U>::type R;
+    constexpr size_t nparts = sizeof(U)/sizeof(R);
+
+    R s[nparts] = {}, c[nparts] = {};
+    for (auto& x : v)
+    {
+        auto parts = reinterpret_cast<const R*>(&x);
+        for (size_t k = 0;k < nparts;k++) neumaier_add(s[k], c[k], parts[k]);
+    }
+
+    for (size_t k = 0;k < nparts;k++) s[k] += c[k];
+
+    U r;
+    memcpy(&r, s, sizeof(U));
+    return r;
+}
+
+template <typename Policy, typename T>
+typename T::value_type sum(Policy policy, const T& v, std::integral_constant<int,2>)
+{
+    typedef typename T::value_type U;
+    typedef typename summation_part<U>::type R;
+    constexpr size_t nparts = sizeof(U)/sizeof(R);
+
+    R s[nparts];
+    sum_parts(policy, reinterpret_cast<const R*>(v.data()), nparts*v.size(), s, nparts);
+
+    U r;
+    memcpy(&r, s, sizeof(U));
+    return r;
+}
+
+}
+
+template <typename Policy, typename T>
+enable_if_t<detail::is_summation_policy<Policy>::value,typename T::value_type>
+sum(Policy policy, const T& v)
+{
+    return detail::sum(policy, v, detail::summation_path<T>());
+}
+
+template <typename T>
+typename T::value_type prod(const T& v)
+{
+    typedef typename T::value_type U;
+    if (v.begin() == v.end()) return U(1);
+    return detail::reduce(v, detail::multiplies_op(), detail::use_simd_reduce<T>());
+}
+
+template <typename T>
+typename T::value_type sum(const parallel_policy& policy, const T& v)
+{
+    typedef typename T::value_type U;
+    if (v.begin() == v.end()) return U();
+    return detail::reduce(policy, v, detail::plus_op(), detail::is_random_access<T>());
+}
+
+template <typename T>
+typename T::value_type prod(const parallel_policy& policy, const T& v)
+{
+    typedef typename T::value_type U;
+    if (v.begin() == v.end()) return U(1);
+    return detail::reduce(policy, v, detail::multiplies_op(), detail::is_random_access<T>());
+}
+
+namespace detail
+{
+
+/*
+ * Containers searched for elements and subsequences with memchr and
+ * find_bytes().
+ */
+template <typename T>
+struct use_byte_search
+: std::integral_constant<bool, is_contiguous<T>::value &&
+                               std::is_integral<typename T::value_type>::value &&
+                               sizeof(typename T::value_type) == 1 &&
+                               !std::is_same<typename T::value_type,bool>::value> {};
+
+/*
+ * Containers compared with memcmp by starts_with and ends_with: those of
+ * integers, for which equality is equality of the bytes.
+ */
+template <typename T>
+struct use_memcmp
+: std::integral_constant<bool, is_contiguous<T>::value &&
+                               std::is_integral<typename T::value_type>::value &&
+                               !std::is_same<typename T::value_type,bool>::value> {};
+
+/*
+ * Whether find(v, s) looks for s as a subsequence of v rather than as an
+ * element: s is a container of the same element type, or a
+ * null-terminated string if v is a container of characters.
+ */
+template <typename T, typename U, typename=void>
+struct is_subsequence
+: std::integral_constant<bool, std::is_pointer<decay_t<U>>::value &&
+                               std::is_same<remove_cv_t<std::remove_pointer_t<decay_t<U>>>,
+                                            typename T::value_type>::value &&
+                               sizeof(typename T::value_type) == 1> {};
+
+template <typename T, typename U>
+struct is_subsequence<T, U, enable_if_t<std::is_same<typename U::value_type,
+                                                     typename T::value_type>::value>>
+: std::true_type {};
+
+template <typename T>
+using const_iterator_t = decltype(std::declval<const T&>().begin());
+
+template <typename T, typename U>
+const_iterator_t<T> find(const T& v, const U& e, std::true_type)
+{
+    typedef typename T::value_type V;
+
+    auto p = v.data();
+    auto q = p == nullptr ? nullptr : std::memchr(p, static_cast<unsigned char>(V(e)), v.size());
+    return v.begin()+(q ? static_cast<const V*>(q)-p : v.size());
+}
+
+template <typename T, typename U>
+const_iterator_t<T> find(const T& v, const U& e, std::false_type)
+{
+    return std::find(v.begin(), v.end(), e);
+}
+
+template <typename T, typename V>
+const_iterator_t<T> search(const T& v, const V* s, size_t m, std::true_type)
+{
+    typedef const unsigned char* bytes;
+    if (m == 0) return v.begin();
+    if (v.size() < m) return v.end();
+    return v.begin()+find_bytes(reinterpret_cast<bytes>(v.data()), v.size(),
+                                reinterpret_cast<bytes>(s), m);
+}
+
+template <typename T, typename V>
+const_iterator_t<T> search(const T& v, const V* s, size_t m, std::false_type)
+{
+    return std::search(v.begin(), v.end(), s, s+m);
+}
+
+template <typename T, typename U>
+const_iterator_t<T> search(const T& v, const U& s, std::true_type)
+{
+    return search(v, s.data(), s.size(), use_byte_search<T>());
+}
+
+template <typename T, typename U>
+const_iterator_t<T> search(const T& v, const U& s, std::false_type)
+{
+    return std::search(v.begin(), v.end(), s.begin(), s.end());
+}
+
+template <typename T, typename V>
+const_iterator_t<T> search(const T& v, const V* s)
+{
+    return search(v, s, std::strlen(reinterpret_cast<const char*>(s)), use_byte_search<T>());
+}
+
+template <typename T, typename U>
+const_iterator_t<T> search(const T& v, const U& s)
+{
+    return search(v, s, std::integral_constant<bool, is_contiguous<U>::value>());
+}
+
+template <typename T, typename V>
+bool equal_at(const T& v, size_t pos, const V* s, size_t m, std::true_type)
+{
+    return m == 0 || std::memcmp(v.data()+pos, s, m*sizeof(V)) == 0;
+}
+
+template <typename T, typename V>
+bool equal_at(const T& v, size_t pos, const V* s, size_t m, std::false_type)
+{
+    return std::equal(s, s+m, std::next(v.begin(), pos));
+}
+
+template <typename T, typename U>
+struct use_memcmp_with
+: std::integral_constant<bool, use_memcmp<T>::value && is_contiguous<U>::value &&
+                               std::is_same<typename T::value_type,typename U::value_type>::value> {};
+
+/*
+ * Whether the container s appears in v at pos.
+ */
+template <typename T, typename U>
+bool equal_at(const T& v, size_t pos, const U& s, std::true_type)
+{
+    return equal_at(v, pos, s.data(), s.size(), std::true_type());
+}
+
+template <typename T, typename U>
+bool equal_at(const T& v, size_t pos, const U& s, std::false_type)
+{
+    return std::equal(s.begin(), s.end(), std::next(v.begin(), pos));
+}
+
+}
+
+/*
+ * The first element of v equal to e, or, if e is a container with the same
+ * element type as v (or a null-terminated string and v a container of
+ * characters), the start of its first occurrence in v. Strings and other
+ * contiguous containers of bytes are searched with vector instructions.
+ */
+template <typename T, typename U>
+enable_if_t<!detail::is_subsequence<T,U>::value,detail::const_iterator_t<T>>
+find(const T& v, const U& e)
+{
+    return detail::find(v, e,
+        std::integral_constant<bool, detail::use_byte_search<T>::value &&
+                                     std::is_same<U,typename T::value_type>::value>());
+}
+
+template <typename T, typename U>
+enable_if_t<detail::is_subsequence<T,U>::value,detail::const_iterator_t<T>>
+find(const T& v, const U& s)
+{
+    return detail::search(v, s);
+}
+
+/*
+ * The start of the first occurrence of s[0,n) in v.
+ */
+template <typename T>
+detail::const_iterator_t<T> find(const T& v, const typename T::value_type* s, size_t n)
+{
+    return detail::search(v, s, n, detail::use_byte_search<T>());
+}
+
+template <typename T, typename Predicate>
+auto find_if(const T& v, Predicate&& pred)
+{
+    return std::find_if(v.begin(), v.end(), std::forward<Predicate>(pred));
+}
+
+template <typename T, typename U>
+auto index_of(const T& v, const U& e)
+{
+    return find(v, e) - v.begin();
+}
+
+template <typename T, typename Predicate>
+auto index_where(const T& v, Predicate&& pred)
+{
+    return find_if(v, std::forward<Predicate>(pred)) - v.begin();
+}
+
+template <typename T, typename U>
+bool contains(const T& v, const U& e)
+{
+    return find(v, e) != v.end();
+}
+
+template <typename T>
+bool contains(const T& v, const typename T::value_type* s, size_t n)
+{
+    return find(v, s, n) != v.end();
+}
+
+template <typename T, typename U>
+auto count(const T& v, const U& e)
+{
+    return std::count(v.begin(), v.end(), e);
+}
+
+template <typename T, typename Predicate>
+bool matches(const T& v, Predicate&& pred)
+{
+    return find_if(v, std::forward<Predicate>(pred)) != v.end();
+}
+
+/*
+ * In the parallel overloads below the predicate is called concurrently
+ * from several threads. matches and contains stop all threads shortly
+ * after any of them finds a hit.
+ */
+template <typename T, typename U>
+bool contains(const parallel_policy& policy, const T& v, const U& e)
+{
+    auto pred = [&e](const typename T::value_type& x) { return x == e; };
+    return detail::matches(policy, v, pred, detail::is_random_access<T>());
+}
+
+template <typename T, typename U>
+auto count(const parallel_policy& policy, const T& v, const U& e)
+{
+    auto pred = [&e](const typename T::value_type& x) { return x == e; };
+    return detail::count_if(policy, v, pred, detail::is_random_access<T>());
+}
+
+template <typename T, typename Predicate>
+bool matches(const parallel_policy& policy, const T& v, Predicate&& pred)
+{
+    return detail::matches(policy, v, pred, detail::is_random_access<T>());
+}
+
+/*
+ * Whether v1 begins with the elements of v2. Containers of integers are
+ * compared with memcmp when v2 is contiguous or a pointer and length, and
+ * a null-terminated v2 is compared as it is read, without taking its
+ * length first.
+ */
+template <typename T>
+bool starts_with(const T& v1, const typename T::value_type* v2, size_t n)
+{
+    if (v1.size() < n)
+        return false;
+
+    return detail::equal_at(v1, 0, v2, n, detail::use_memcmp<T>());
+}
+
+template <typename T, typename U>
+std::enable_if_t<!std::is_same<U,typename T::value_type>::value,bool>
+starts_with(const T& v1, const U& v2)
+{
+    if (v1.size() < v2.size())
+        return false;
+
+    return detail::equal_at(v1, 0, v2, detail::use_memcmp_with<T,U>());
+}
+
+template <typename T>
+bool starts_with(const T& v1, const char* v2)
+{
+    for (auto i = v1.begin();*v2;++i, ++v2)
+    {
+        if (i == v1.end() || !(*i == *v2)) return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool starts_with(const T& v, const typename T::value_type& e)
+{
+    if (v.empty())
+        return false;
+
+    return *v.begin() == e;
+}
+
+template <typename T>
+bool ends_with(const T& v1, const typename T::value_type* v2, size_t n)
+{
+    if (v1.size() < n)
+        return false;
+
+    return detail::equal_at(v1, v1.size()-n, v2, n, detail::use_memcmp<T>());
+}
+
+template <typename T, typename U>
+std::enable_if_t<!std::is_same<U,typename T::value_type>::value,bool>
+ends_with(const T& v1, const U& v2)
+{
+    if (v1.size() < v2.size())
+        return false;
+
+    return detail::equal_at(v1, v1.size()-v2.size(), v2, detail::use_memcmp_with<T,U>());
+}
+
+template <typename T>
+bool ends_with(const T& v1, const char* v2)
+{
+    auto len = strlen(v2);
+
+    if (v1.size() < len)
+        return false;
+
+    return std::equal(v2, v2+len, std::next(v1.begin(), v1.size()-len));
+}
+
+template <typename T>
+bool ends_with(const T& v, const typename T::value_type& e)
+{
+    if (v.empty())
+        return false;
+
+    return *v.rbegin() == e;
+}
+
+template <typename T, typename Predicate>
+auto count_if(const T& v, Predicate&& pred)
+{
+    return std::count_if(v.begin(), v.end(), std::forward<Predicate>(pred));
+}
+
+template <typename T, typename Predicate>
+auto count_if(const parallel_policy& policy, const T& v, Predicate&& pred)
+{
+    return detail::count_if(policy, v, pred, detail::is_random_access<T>());
+}
+
+template <typename T>
+T& sort(T& v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+template <typename T, typename Compare>
+T& sort(T& v, const Compare& comp)
+{
+    std::sort(v.begin(), v.end(), comp);
+    return v;
+}
+
+template <typename T>
+T sorted(T v)
+{
+    sort(v);
+    return v;
+}
+
+template <typename T, typename Compare>
+T sorted(T v, const Compare& comp)
+{
+    sort(v, comp);
+    return v;
+}
+
+/*
+ * As sorted(v), but into the existing container out, reusing its storage.
+ */
+template <typename T>
+T& sorted(const T& v, T& out)
+{
+    if (&out != &v) out.assign(v.begin(), v.end());
+    return sort(out);
+}
+
+template <typename T, typename Compare>
+T& sorted(const T& v, const Compare& comp, T& out)
+{
+    if (&out != &v) out.assign(v.begin(), v.end());
+    return sort(out, comp);
+}
+
+/*
+ * Write the elements of v in order to the random-access range starting at
+ * d_first, and return its end.
+ */
+template <typename T, typename RandomIt>
+RandomIt sort_copy(const T& v, RandomIt d_first)
+{
+    RandomIt d_last = std::copy(v.begin(), v.end(), d_first);
+    std::sort(d_first, d_last);
+    return d_last;
+}
+
+template <typename T, typename RandomIt, typename Compare>
+RandomIt sort_copy(const T& v, RandomIt d_first, Compare comp)
+{
+    RandomIt d_last = std::copy(v.begin(), v.end(), d_first);
+    std::sort(d_first, d_last, comp);
+    return d_last;
+}
+
+namespace detail
+{
+
+/*
+ * Sort p[0,n) with an LSD radix sort of its keys alone and drop repeated
+ * keys while decoding the result. Returns the number of distinct keys.
+ */
+template <typename U>
+size_t radix_sort_unique(U* p, size_t n)
+{
+    typedef radix_key<U> traits;
+    typedef typename traits::type radix_type;
+    constexpr int npass = sizeof(radix_type);
+
+    std::vector<radix_type> buf(n), scratch(n);
+    std::vector<size_t> counts(npass*256);
+
+    for (size_t i = 0;i < n;i++)
+    {
+        radix_type u = traits::encode(p[i]);
+        buf[i] = u;
+        for (int d = 0;d < npass;d++) counts[256*d + ((u >> 8*d) & 0xff)]++;
+    }
+
+    radix_type* from = buf.data();
+    radix_type* to = scratch.data();
+
+    for (int d = 0;d < npass;d++)
+    {
+        size_t* count = &counts[256*d];
+        if (count[(from[0] >> 8*d) & 0xff] == n) continue;
+
+        size_t offset = 0;
+        for (int b = 0;b < 256;b++)
+        {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0;i < n;i++) to[count[(from[i] >> 8*d) & 0xff]++] = from[i];
+
+        std::swap(from, to);
+    }
+
+    size_t k = 1;
+    p[0] = traits::decode(from[0]);
+    for (size_t i = 1;i < n;i++)
+    {
+        if (from[i] != from[i-1]) p[k++] = traits::decode(from[i]);
+    }
+
+    return k;
+}
+
+/*
+ * Integral elements of contiguous containers are sorted for unique with
+ * the radix sort, once there are enough of them.
+ */
+template <typename T>
+using use_radix_unique =
+    std::integral_constant<bool, is_contiguous<T>::value &&
+                                 is_integral<typename T::value_type>::value &&
+                                 !std::is_same<typename T::value_type,bool>::value>;
+
+/*
+ * Sort and remove duplicates from v[b,e), leaving the distinct elements
+ * at the front. Returns their number.
+ */
+template <typename T>
+size_t sort_unique(T& v, size_t b, size_t e, std::false_type)
+{
+    auto first = v.begin()+b;
+    std::sort(first, v.begin()+e);
+    return std::unique(first, v.begin()+e)-first;
+}
+
+template <typename T>
+size_t sort_unique(T& v, size_t b, size_t e, std::true_type)
+{
+    typedef typename T::value_type U;
+
+    if (e-b >= size_t(min_radix_cosort_size<U>()))
+        return radix_sort_unique(&v[0]+b, e-b);
+
+    return sort_unique(v, b, e, std::false_type());
+}
+
+template <typename T>
+T& unique(T& v, std::true_type)
+{
+    if (v.empty()) return v;
+    v.resize(sort_unique(v, 0, v.size(), std::true_type()));
+    return v;
+}
+
+template <typename T>
+T& unique(T& v, std::false_type)
+{
+    sort(v);
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+/*
+ * Sort and deduplicate chunks concurrently, then merge neighbouring runs
+ * pairwise (each round's merges also running concurrently) and remove the
+ * duplicates which were in different chunks.
+ */
+template <typename T>
+T& unique(const parallel_policy& policy, T& v, std::true_type)
+{
+    size_t n = v.size();
+    size_t nchunk = num_chunks(policy, n, 1 << 14);
+    if (nchunk <= 1) return unique(v, use_radix_unique<T>());
+
+    std::vector<size_t> bounds(nchunk+1), sizes(nchunk);
+    for (size_t i = 0;i <= nchunk;i++) bounds[i] = chunk_begin(n, nchunk, i);
+
+    parallel_chunks(nchunk, n,
+    [&](size_t c, size_t from, size_t to)
+    {
+        sizes[c] = sort_unique(v, from, to, use_radix_unique<T>());
+    });
+
+    auto first = v.begin();
+    for (size_t c = 1;c <= nchunk;c++)
+    {
+        size_t start = bounds[c-1];
+        bounds[c-1] = c == 1 ? 0 : bounds[c-2]+sizes[c-2];
+        if (start != bounds[c-1])
+            std::move(first+start, first+start+sizes[c-1], first+bounds[c-1]);
+    }
+    bounds[nchunk] = bounds[nchunk-1]+sizes[nchunk-1];
+
+    for (size_t width = 1;width < nchunk;width *= 2)
+    {
+        size_t nmerge = (nchunk+2*width-1)/(2*width);
+        parallel_chunks(nmerge, nmerge,
+        [&](size_t i, size_t, size_t)
+        {
+            size_t lo = 2*width*i;
+            size_t mid = std::min(lo+width, nchunk);
+            size_t hi = std::min(lo+2*width, nchunk);
+            if (mid == hi) return;
+            std::inplace_merge(first+bounds[lo], first+bounds[mid], first+bounds[hi]);
+        });
+    }
+
+    v.erase(std::unique(first, first+bounds[nchunk]), v.end());
+    return v;
+}
+
+template <typename T>
+T& unique(const parallel_policy&, T& v, std::false_type)
+{
+    return unique(v, std::false_type());
+}
+
+}
+
+/*
+ * Sort v and remove repeated elements. Integral elements are sorted with
+ * a radix sort.
+ */
+template <typename T>
+T& unique(T& v)
+{
+    return detail::unique(v, detail::use_radix_unique<T>());
+}
+
+template <typename T>
+T uniqued(T v)
+{
+    unique(v);
+    return v;
+}
+
+/*
+ * As unique(v), with chunks of v sorted and merged concurrently.
+ */
+template <typename T>
+T& unique(const parallel_policy& policy, T& v)
+{
+    return detail::unique(policy, v,
+        std::integral_constant<bool, detail::is_random_access<T>::value &&
+                                     !std::is_same<typename T::value_type,bool>::value>());
+}
+
+template <typename T>
+T uniqued(const parallel_policy& policy, T v)
+{
+    unique(policy, v);
+    return v;
+}
+
+/*
+ * As uniqued(v), but into the existing container out, reusing its storage.
+ */
+template <typename T>
+T& uniqued(const T& v, T& out)
+{
+    if (&out != &v) out.assign(v.begin(), v.end());
+    return unique(out);
+}
+
+template <typename T>
+T& uniqued(const parallel_policy& policy, const T& v, T& out)
+{
+    if (&out != &v) out.assign(v.begin(), v.end());
+    return unique(policy, out);
+}
+
+/*
+ * Write the distinct elements of v in order to the random-access range
+ * starting at d_first, and return the end of the output.
+ */
+template <typename T, typename RandomIt>
+RandomIt unique_copy(const T& v, RandomIt d_first)
+{
+    RandomIt d_last = sort_copy(v, d_first);
+    return std::unique(d_first, d_last);
+}
+
+template <typename T, typename I>
+T& rotate(T& v, I n)
+{
+    if (n > 0)
+    {
+        std::rotate(v.begin(), std::next(v.begin(), n), v.end());
+    }
+    else if (n < 0)
+    {
+        std::rotate(v.begin(), std::next(v.end(), n), v.end());
+    }
+    return v;
+}
+
+/*
+ * Hash-based set operations. These treat their inputs as multisets, do not
+ * sort, and keep the surviving elements of v1 in their original order
+ * (followed, for hash_unite and hash_mutual_exclusion, by the surviving
+ * elements of v2 in their original order).
+ */
+template <typename T>
+T& hash_intersect(T& v1, const T& v2)
+{
+    typedef typename T::value_type V;
+
+    auto common = detail::common_counts(v1, v2);
+
+    return filter(v1,
+    [&common](const V& e)
+    {
+        auto it = common.find(e);
+        if (it == common.end() || it->second == 0) return false;
+        it->second--;
+        return true;
+    });
+}
+
+template <typename T>
+T& hash_exclude(T& v1, const T& v2)
+{
+    typedef typename T::value_type V;
+
+    auto common = detail::common_counts(v1, v2);
+
+    return filter(v1,
+    [&common](const V& e)
+    {
+        auto it = common.find(e);
+        if (it == common.end() || it->second == 0) return true;
+        it->second--;
+        return false;
+    });
+}
+
+template <typename T>
+T& hash_unite(T& v1, const T& v2)
+{
+    auto common = detail::common_counts(v1, v2);
+
+    for (auto& e : v2)
+    {
+        auto it = common.find(e);
+        if (it == common.end() || it->second == 0)
+        {
+            v1.push_back(e);
+        }
+        else
+        {
+            it->second--;
+        }
+    }
+
+    return v1;
+}
+
+template <typename T>
+T hash_mutual_exclusion(T v1, const T& v2)
+{
+    typedef typename T::value_type V;
+
+    auto common1 = detail::common_counts(v1, v2);
+    auto common2 = common1;
+
+    filter(v1,
+    [&common1](const V& e)
+    {
+        auto it = common1.find(e);
+        if (it == common1.end() || it->second == 0) return true;
+        it->second--;
         return false;
+    });
+
+    for (auto& e : v2)
+    {
+        auto it = common2.find(e);
+        if (it == common2.end() || it->second == 0)
+        {
+            v1.push_back(e);
+        }
+        else
+        {
+            it->second--;
+        }
+    }
+
+    return v1;
+}
+
+namespace detail
+{
+
+inline uint64_t mix_hash(uint64_t h)
+{
+    return h*0x9e3779b97f4a7c15ull;
+}
+
+/*
+ * Set of integers with open addressing and linear probing, which grows to
+ * stay at most half full. Much faster than std::unordered_set since it
+ * never allocates per element.
+ */
+template <typename U>
+class integer_set
+{
+    private:
+        std::vector<U> keys_;
+        std::vector<uint8_t> used_;
+        size_t size_ = 0;
+        int shift_ = 64;
+
+        size_t slot(const U& x) const
+        {
+            return size_t(mix_hash(uint64_t(x)) >> shift_);
+        }
+
+        void allocate(size_t capacity)
+        {
+            int bits = 4;
+            while ((size_t(1) << bits) < capacity) bits++;
+            keys_.assign(size_t(1) << bits, U());
+            used_.assign(size_t(1) << bits, 0);
+            shift_ = 64-bits;
+        }
+
+        void grow()
+        {
+            std::vector<U> keys; keys.swap(keys_);
+            std::vector<uint8_t> used; used.swap(used_);
+            allocate(2*keys.size());
+            for (size_t i = 0;i < keys.size();i++)
+                if (used[i]) place(keys[i]);
+        }
+
+        void place(const U& x)
+        {
+            size_t mask = keys_.size()-1;
+            size_t i = slot(x);
+            while (used_[i]) i = (i+1) & mask;
+            keys_[i] = x;
+            used_[i] = 1;
+        }
+
+    public:
+        explicit integer_set(size_t n) { allocate(2*n); }
+
+        /*
+         * Add x, returning whether it was not already present.
+         */
+        bool insert(const U& x)
+        {
+            size_t mask = keys_.size()-1;
+            for (size_t i = slot(x);used_[i];i = (i+1) & mask)
+                if (keys_[i] == x) return false;
+
+            if (2*(size_+1) > keys_.size()) grow();
+            place(x);
+            size_++;
+            return true;
+        }
+};
+
+template <typename U>
+class hash_set
+{
+    private:
+        std::unordered_set<U> set_;
+
+    public:
+        explicit hash_set(size_t n) : set_(n) {}
+
+        bool insert(const U& x) { return set_.insert(x).second; }
+};
+
+template <typename U>
+using seen_set = conditional_t<is_integral<U>::value && !std::is_same<U,bool>::value,
+                               integer_set<U>, hash_set<U>>;
+
+template <typename T>
+T& hash_unique(T& v)
+{
+    typedef typename T::value_type U;
+
+    seen_set<U> seen(v.size());
+    return stl_ext::filter(v, [&seen](const U& e) { return seen.insert(e); });
+}
+
+template <typename U>
+size_t hash_shard(const U& x, size_t nshard)
+{
+    return size_t(mix_hash(std::hash<U>()(x)) >> 32) % nshard;
+}
+
+/*
+ * Each thread owns the elements whose hash falls in its shard and marks
+ * their first occurrences; the marked elements are then kept in order.
+ * The positions are first bucketed by shard (counting, then scattering,
+ * chunk by chunk in parallel) so that each thread only visits its own.
+ */
+template <typename T>
+T& hash_unique(const parallel_policy& policy, T& v, std::true_type)
+{
+    typedef typename T::value_type U;
+
+    size_t n = v.size();
+    size_t nshard = num_chunks(policy, n, 1 << 14);
+    if (nshard <= 1) return hash_unique(v);
+
+    auto first = v.begin();
+    std::vector<size_t> offset(nshard*nshard);
+    parallel_chunks(nshard, n,
+    [&](size_t c, size_t from, size_t to)
+    {
+        size_t* count = &offset[c*nshard];
+        for (size_t i = from;i < to;i++) count[hash_shard(first[i], nshard)]++;
+    });
+
+    std::vector<size_t> shard_begin(nshard+1);
+    size_t total = 0;
+    for (size_t s = 0;s < nshard;s++)
+    {
+        shard_begin[s] = total;
+        for (size_t c = 0;c < nshard;c++)
+        {
+            size_t count = offset[c*nshard+s];
+            offset[c*nshard+s] = total;
+            total += count;
+        }
+    }
+    shard_begin[nshard] = total;
+
+    std::vector<size_t> pos(n);
+    parallel_chunks(nshard, n,
+    [&](size_t c, size_t from, size_t to)
+    {
+        size_t* next = &offset[c*nshard];
+        for (size_t i = from;i < to;i++) pos[next[hash_shard(first[i], nshard)]++] = i;
+    });
+
+    std::vector<uint8_t> keep(n);
+    parallel_chunks(nshard, nshard,
+    [&](size_t s, size_t, size_t)
+    {
+        seen_set<U> seen(shard_begin[s+1]-shard_begin[s]);
+        for (size_t j = shard_begin[s];j < shard_begin[s+1];j++)
+            keep[pos[j]] = seen.insert(first[pos[j]]);
+    });
+
+    size_t i = 0;
+    return stl_ext::filter(v, [&](const U&) { return keep[i++] != 0; });
+}
+
+template <typename T>
+T& hash_unique(const parallel_policy&, T& v, std::false_type)
+{
+    return hash_unique(v);
+}
+
+}
+
+/*
+ * Remove repeated elements, keeping the first occurrence of each in its
+ * original position, in linear time. The elements must be hashable.
+ */
+template <typename T>
+T& hash_unique(T& v)
+{
+    return detail::hash_unique(v);
+}
+
+template <typename T>
+T hash_uniqued(T v)
+{
+    hash_unique(v);
+    return v;
+}
+
+/*
+ * As hash_unique(v), with the elements split by hash between threads.
+ */
+template <typename T>
+T& hash_unique(const parallel_policy& policy, T& v)
+{
+    return detail::hash_unique(policy, v, detail::is_random_access<T>());
+}
+
+template <typename T>
+T hash_uniqued(const parallel_policy& policy, T v)
+{
+    hash_unique(policy, v);
+    return v;
+}
+
+namespace detail
+{
+
+/*
+ * t.reserve(n) for the containers which have it, e.g. not std::deque.
+ */
+template <typename T>
+auto reserve(T& t, size_t n, int) -> decltype(void(t.reserve(n)))
+{
+    t.reserve(n);
+}
+
+template <typename T>
+void reserve(T&, size_t, long) {}
+
+/*
+ * std::lower_bound, but searching forward from first in steps of doubling
+ * size so that the cost is logarithmic in the distance travelled rather
+ * than in the length of the range.
+ */
+template <typename Iterator, typename U>
+Iterator gallop(Iterator first, Iterator last, const U& value)
+{
+    auto n = last-first;
+    decltype(n) lo = 0, hi = 1;
+
+    while (hi < n && first[hi] < value)
+    {
+        lo = hi+1;
+        hi *= 2;
+    }
+
+    return std::lower_bound(first+lo, first+std::min(hi, n), value);
+}
+
+/*
+ * The sorted set operations gallop through the larger input instead of
+ * stepping through it when it is at least this many times bigger.
+ */
+constexpr size_t gallop_ratio = 8;
+
+template <typename Iterator>
+Iterator move_down(Iterator first, Iterator last, Iterator d_first)
+{
+    if (first == d_first) return last;
+    return std::move(first, last, d_first);
+}
+
+template <bool Move, typename T, typename U>
+T& sorted_unite(T& v1, U& v2)
+{
+    size_t n1 = v1.size();
+    bool skewed = v2.size()*gallop_ratio <= n1;
+    reserve(v1, n1+v2.size(), 0);
+
+    /* indices rather than iterators: push_back invalidates a deque's */
+    size_t j1 = 0;
+    for (auto& e : v2)
+    {
+        if (skewed)
+        {
+            j1 = gallop(v1.begin()+j1, v1.begin()+n1, e)-v1.begin();
+        }
+        else
+        {
+            while (j1 < n1 && v1[j1] < e) j1++;
+        }
+
+        if (j1 < n1 && !(e < v1[j1]))
+        {
+            j1++;
+        }
+        else if (Move)
+        {
+            v1.push_back(std::move(e));
+        }
+        else
+        {
+            v1.push_back(e);
+        }
+    }
+
+    std::inplace_merge(v1.begin(), v1.begin()+n1, v1.end());
+    return v1;
+}
+
+template <typename T, typename... Ts>
+std::vector<T> sorted_copies(Ts&&... vs)
+{
+    std::vector<T> copies;
+    copies.reserve(sizeof...(Ts));
+    int expand[] = {0, (copies.emplace_back(std::forward<Ts>(vs)), 0)...};
+    (void)expand;
+    for (auto& v : copies) std::sort(v.begin(), v.end());
+    return copies;
+}
+
+/*
+ * Move the elements common to every [first[i], last[i]) down to out, by
+ * repeatedly galloping each input up to the largest current head. Stops
+ * as soon as any input is exhausted and returns the end of the output.
+ */
+template <typename Iterator>
+Iterator intersect_runs(std::vector<Iterator>& first,
+                        const std::vector<Iterator>& last, Iterator out)
+{
+    size_t k = first.size();
+
+    while (true)
+    {
+        size_t top = 0;
+        for (size_t i = 0;i < k;i++)
+        {
+            if (first[i] == last[i]) return out;
+            if (*first[top] < *first[i]) top = i;
+        }
+
+        bool match = true;
+        for (size_t i = 0;i < k;i++)
+        {
+            first[i] = gallop(first[i], last[i], *first[top]);
+            if (first[i] == last[i]) return out;
+            if (*first[top] < *first[i]) match = false;
+        }
+
+        if (!match) continue;
+
+        auto run = last[0]-first[0];
+        for (size_t i = 0;i < k;i++)
+        {
+            auto end = first[i];
+            while (end != last[i] && !(*first[i] < *end)) ++end;
+            run = std::min(run, end-first[i]);
+        }
+
+        out = move_down(first[0], first[0]+run, out);
+        for (size_t i = 0;i < k;i++) first[i] += run;
+    }
+}
+
+/*
+ * Intersection of v1 with every container in vs, all sorted, in one pass.
+ */
+template <typename T>
+T& multi_intersect(T& v1, std::vector<T>& vs)
+{
+    typedef typename T::iterator iterator;
+
+    size_t k = vs.size()+1;
+    std::vector<iterator> first(k), last(k);
+    first[0] = v1.begin();
+    last[0] = v1.end();
+    for (size_t i = 1;i < k;i++)
+    {
+        first[i] = vs[i-1].begin();
+        last[i] = vs[i-1].end();
+    }
+
+    v1.erase(intersect_runs(first, last, v1.begin()), v1.end());
+    return v1;
+}
+
+/*
+ * Union of v1 with every container in vs, all sorted, in one k-way merge
+ * through a heap of the inputs keyed on their current heads. Each
+ * distinct element is written as many times as it occurs in the input
+ * where it is most frequent.
+ */
+template <typename T>
+T& multi_unite(T& v1, std::vector<T>& vs)
+{
+    typedef typename T::iterator iterator;
+
+    size_t k = vs.size()+1;
+    std::vector<iterator> first(k), last(k), run_end(k);
+    first[0] = v1.begin();
+    last[0] = v1.end();
+    for (size_t i = 1;i < k;i++)
+    {
+        first[i] = vs[i-1].begin();
+        last[i] = vs[i-1].end();
+    }
+
+    size_t total = 0;
+    std::vector<size_t> heap;
+    for (size_t i = 0;i < k;i++)
+    {
+        total += last[i]-first[i];
+        if (first[i] != last[i]) heap.push_back(i);
+    }
+
+    auto later = [&first](size_t i, size_t j) { return *first[j] < *first[i]; };
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    T out;
+    reserve(out, total, 0);
+    std::vector<size_t> group;
+
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        group.push_back(heap.back());
+        heap.pop_back();
+
+        while (!heap.empty() && !(*first[group[0]] < *first[heap.front()]))
+        {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            group.push_back(heap.back());
+            heap.pop_back();
+        }
+
+        size_t longest = group[0];
+        for (auto i : group)
+        {
+            run_end[i] = first[i];
+            while (run_end[i] != last[i] && !(*first[i] < *run_end[i])) ++run_end[i];
+            if (run_end[i]-first[i] > run_end[longest]-first[longest]) longest = i;
+        }
+
+        std::move(first[longest], run_end[longest], std::back_inserter(out));
+
+        for (auto i : group)
+        {
+            first[i] = run_end[i];
+            if (first[i] == last[i]) continue;
+            heap.push_back(i);
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+
+        group.clear();
+    }
+
+    v1.swap(out);
+    return v1;
+}
+
+}
+
+/*
+ * Set operations on inputs which are already sorted in ascending order.
+ * These neither copy nor sort their inputs, work on v1 in place, and
+ * gallop through the larger input when the sizes are very different. The
+ * second input must not be the same object as the first.
+ */
+template <typename T>
+T& sorted_intersect(T& v1, const T& v2)
+{
+    auto i1 = v1.begin();
+    auto i2 = v2.begin();
+    auto i3 = v1.begin();
+
+    if (v2.size()*detail::gallop_ratio <= v1.size())
+    {
+        for (;i2 != v2.end();++i2)
+        {
+            i1 = detail::gallop(i1, v1.end(), *i2);
+            if (i1 == v1.end()) break;
+
+            if (!(*i2 < *i1))
+            {
+                *i3 = std::move(*i1);
+                ++i1;
+                ++i3;
+            }
+        }
+    }
+    else if (v1.size()*detail::gallop_ratio <= v2.size())
+    {
+        for (;i1 != v1.end();++i1)
+        {
+            i2 = detail::gallop(i2, v2.end(), *i1);
+            if (i2 == v2.end()) break;
+
+            if (!(*i1 < *i2))
+            {
+                *i3 = std::move(*i1);
+                ++i2;
+                ++i3;
+            }
+        }
+    }
+    else
+    {
+        while (i1 != v1.end() && i2 != v2.end())
+        {
+            if (*i1 < *i2)
+            {
+                ++i1;
+            }
+            else if (*i2 < *i1)
+            {
+                ++i2;
+            }
+            else
+            {
+                *i3 = std::move(*i1);
+                ++i1;
+                ++i2;
+                ++i3;
+            }
+        }
+    }
+
+    v1.erase(i3, v1.end());
+    return v1;
+}
+
+template <typename T>
+T& sorted_unite(T& v1, const T& v2)
+{
+    return detail::sorted_unite<false>(v1, v2);
+}
+
+template <typename T>
+T& sorted_unite(T& v1, T&& v2)
+{
+    return detail::sorted_unite<true>(v1, v2);
+}
+
+template <typename T>
+T& sorted_exclude(T& v1, const T& v2)
+{
+    auto i1 = v1.begin();
+    auto i2 = v2.begin();
+    auto i3 = v1.begin();
+
+    if (v2.size()*detail::gallop_ratio <= v1.size())
+    {
+        for (;i2 != v2.end() && i1 != v1.end();++i2)
+        {
+            auto pos = detail::gallop(i1, v1.end(), *i2);
+            i3 = detail::move_down(i1, pos, i3);
+            i1 = pos;
+            if (i1 != v1.end() && !(*i2 < *i1)) ++i1;
+        }
+    }
+    else if (v1.size()*detail::gallop_ratio <= v2.size())
+    {
+        for (;i1 != v1.end() && i2 != v2.end();++i1)
+        {
+            i2 = detail::gallop(i2, v2.end(), *i1);
+
+            if (i2 != v2.end() && !(*i1 < *i2))
+            {
+                ++i2;
+            }
+            else
+            {
+                *i3 = std::move(*i1);
+                ++i3;
+            }
+        }
+    }
+    else
+    {
+        while (i1 != v1.end() && i2 != v2.end())
+        {
+            if (*i1 < *i2)
+            {
+                *i3 = std::move(*i1);
+                ++i1;
+                ++i3;
+            }
+            else if (*i2 < *i1)
+            {
+                ++i2;
+            }
+            else
+            {
+                ++i1;
+                ++i2;
+            }
+        }
+    }
 
-    return std::equal(v2.begin(), v2.end(), v1.begin());
+    i3 = detail::move_down(i1, v1.end(), i3);
+    v1.erase(i3, v1.end());
+    return v1;
 }
 
 template <typename T>
-bool starts_with(const T& v1, const char* v2)
+T sorted_mutual_exclusion(const T& v1, const T& v2)
 {
-    auto len = strlen(v2);
+    T v3;
+    std::set_symmetric_difference(v1.begin(), v1.end(), v2.begin(), v2.end(),
+                                  std::back_inserter(v3));
+    return v3;
+}
 
-    if (v1.size() < len)
-        return false;
+/*
+ * The set operations below return sorted results. When one input is much
+ * smaller than the other and the elements can be hashed, only the smaller
+ * input is hashed and nothing but the result is sorted.
+ */
+template <typename T>
+T& intersect(T& v1, const T& v2)
+{
+    if (detail::prefer_hash_set_op(v1, v2)) return sort(hash_intersect(v1, v2));
 
-    return std::equal(v2, v2+len, v1.begin());
+    T tmp(v2);
+    return sorted_intersect(sort(v1), sort(tmp));
 }
 
 template <typename T>
-bool starts_with(const T& v, const typename T::value_type& e)
+T& intersect(T& v1, T&& v2)
 {
-    if (v.empty())
-        return false;
+    if (detail::prefer_hash_set_op(v1, v2)) return sort(hash_intersect(v1, v2));
 
-    return *v.begin() == e;
+    return sorted_intersect(sort(v1), sort(v2));
 }
 
-template <typename T, typename U>
-std::enable_if_t<!std::is_same<U,typename T::value_type>::value,bool>
-ends_with(const T& v1, const U& v2)
+template <typename T, typename U, typename... Ts>
+enable_if_t<(sizeof...(Ts) > 0),T&>
+intersect(T& v1, U&& v2, Ts&&... vs)
 {
-    if (v1.size() < v2.size())
-        return false;
+    auto others = detail::sorted_copies<T>(std::forward<U>(v2), std::forward<Ts>(vs)...);
+    return detail::multi_intersect(sort(v1), others);
+}
 
-    return std::equal(v2.rbegin(), v2.rend(), v1.rbegin());
+template <typename T, typename... Ts>
+T intersection(T v1, Ts&&... vs)
+{
+    intersect(v1, std::forward<Ts>(vs)...);
+    return v1;
 }
 
 template <typename T>
-bool ends_with(const T& v1, const char* v2)
+T& unite(T& v1, T v2)
 {
-    auto len = strlen(v2);
+    return sorted_unite(sort(v1), std::move(sort(v2)));
+}
 
-    if (v1.size() < len)
-        return false;
+template <typename T, typename U, typename... Ts>
+enable_if_t<(sizeof...(Ts) > 0),T&>
+unite(T& v1, U&& v2, Ts&&... vs)
+{
+    auto others = detail::sorted_copies<T>(std::forward<U>(v2), std::forward<Ts>(vs)...);
+    return detail::multi_unite(sort(v1), others);
+}
 
-    return std::equal(v2, v2+len, std::next(v1.begin(), v1.size()-len));
+template <typename T, typename... Ts>
+T union_of(T v1, Ts&&... vs)
+{
+    unite(v1, std::forward<Ts>(vs)...);
+    return v1;
 }
 
 template <typename T>
-bool ends_with(const T& v, const typename T::value_type& e)
+T& exclude(T& v1, const T& v2)
 {
-    if (v.empty())
-        return false;
+    if (detail::prefer_hash_set_op(v1, v2)) return sort(hash_exclude(v1, v2));
 
-    return *v.rbegin() == e;
+    T tmp(v2);
+    return sorted_exclude(sort(v1), sort(tmp));
 }
 
-template <typename T, typename Predicate>
-auto count_if(const T& v, Predicate&& pred)
+template <typename T>
+T& exclude(T& v1, T&& v2)
 {
-    return std::count_if(v.begin(), v.end(), std::forward<Predicate>(pred));
+    if (detail::prefer_hash_set_op(v1, v2)) return sort(hash_exclude(v1, v2));
+
+    return sorted_exclude(sort(v1), sort(v2));
 }
 
-template <typename T>
-T& sort(T& v)
+template <typename T, typename U, typename... Ts>
+enable_if_t<(sizeof...(Ts) > 0),T&>
+exclude(T& v1, U&& v2, Ts&&... vs)
 {
-    std::sort(v.begin(), v.end());
-    return v;
+    exclude(v1, std::forward<U>(v2));
+    exclude(v1, std::forward<Ts>(vs)...);
+    return v1;
 }
 
-template <typename T, typename Compare>
-T& sort(T& v, const Compare& comp)
+template <typename T, typename... Ts>
+T exclusion(T v1, Ts&&... vs)
 {
-    std::sort(v.begin(), v.end(), comp);
-    return v;
+    exclude(v1, std::forward<Ts>(vs)...);
+    return v1;
 }
 
 template <typename T>
-T sorted(T v)
+T mutual_exclusion(T v1, T v2)
 {
-    sort(v);
-    return v;
+    T v3;
+    sort(v1);
+    sort(v2);
+    std::set_symmetric_difference(std::make_move_iterator(v1.begin()),
+                                  std::make_move_iterator(v1.end()),
+                                  std::make_move_iterator(v2.begin()),
+                                  std::make_move_iterator(v2.end()),
+                                  std::back_inserter(v3));
+    return v3;
 }
 
-template <typename T, typename Compare>
-T sorted(T v, const Compare& comp)
+/*
+ * Tag selecting the mask overloads which take a packed bit mask: a
+ * container of unsigned integer words, element i of v being kept if bit
+ * i%w of word i/w is set (w being the number of bits per word).
+ */
+struct packed_bits_policy {};
+constexpr packed_bits_policy packed_bits;
+
+namespace detail
 {
-    sort(v, comp);
-    return v;
-}
 
-template <typename T>
-T& unique(T& v)
+/*
+ * Selections for compact() by a mask with one element per element of v,
+ * read in order, and by a mask of packed bits.
+ */
+template <typename Iterator>
+struct mask_selection
 {
-    sort(v);
-    v.erase(std::unique(v.begin(), v.end()), v.end());
-    return v;
-}
+    Iterator it;
 
-template <typename T>
-T uniqued(T v)
+    template <typename Pointer>
+    uint64_t operator()(Pointer, size_t, size_t n)
+    {
+        uint64_t bits = 0;
+        for (size_t j = 0;j < n;j++, ++it) bits |= uint64_t(bool(*it)) << j;
+        return bits;
+    }
+
+    template <typename U>
+    bool operator()(size_t, U&&)
+    {
+        return bool(*it++);
+    }
+};
+
+template <typename U>
+mask_selection<typename U::const_iterator> select_by_mask(const U& m)
 {
-    unique(v);
-    return v;
+    return {m.begin()};
 }
 
-template <typename T, typename I>
-T& rotate(T& v, I n)
+template <typename U>
+struct packed_bits_selection
 {
-    if (n > 0)
+    typedef typename U::value_type word;
+    static constexpr size_t w = 8*sizeof(word);
+
+    const U& m;
+
+    template <typename Pointer>
+    uint64_t operator()(Pointer, size_t i, size_t n) const
     {
-        std::rotate(v.begin(), std::next(v.begin(), n), v.end());
+        uint64_t bits = 0;
+        for (size_t j = 0;j < n;j += w) bits |= uint64_t(m[(i+j)/w]) << j;
+        return bits;
     }
-    else if (n < 0)
+
+    template <typename V>
+    bool operator()(size_t i, V&&) const
     {
-        std::rotate(v.begin(), std::next(v.end(), n), v.end());
+        return bool((m[i/w] >> (i%w)) & 1);
     }
+};
+
+template <typename U>
+packed_bits_selection<U> select_by_packed_bits(const U& m)
+{
+    typedef typename U::value_type word;
+    static_assert(std::is_unsigned<word>::value && !std::is_same<word,bool>::value &&
+                  64%(8*sizeof(word)) == 0,
+                  "packed bit masks must be made of unsigned words of at most 64 bits");
+
+    return {m};
+}
+
+}
+
+template <typename T, typename U>
+T& mask(T& v, const U& m)
+{
+    return detail::compact(v, detail::select_by_mask(m), detail::use_compress<T>());
+}
+
+template <typename T, typename U>
+T& mask(packed_bits_policy, T& v, const U& m)
+{
+    return detail::compact(v, detail::select_by_packed_bits(m), detail::use_compress<T>());
+}
+
+template <typename T, typename U>
+T masked(T v, const U& m)
+{
+    mask(v, m);
     return v;
 }
 
-template <typename T>
-T& intersect(T& v1, T v2)
+template <typename T, typename U>
+T masked(packed_bits_policy, T v, const U& m)
 {
-    sort(v1);
-    sort(v2);
+    mask(packed_bits, v, m);
+    return v;
+}
 
-    auto i1 = v1.begin();
-    auto i2 = v2.begin();
-    auto i3 = v1.begin();
-    while (i1 != v1.end() && i2 != v2.end())
-    {
-        if (*i1 < *i2)
-        {
-            ++i1;
-        }
-        else if (*i2 < *i1)
-        {
-            ++i2;
-        }
-        else
-        {
-            *i3 = std::move(*i1);
-            ++i1;
-            ++i2;
-            ++i3;
-        }
-    }
-    v1.erase(i3, v1.end());
+/*
+ * As masked(v, m), but into the existing container out, reusing its
+ * storage. Only the elements which are kept are copied.
+ */
+template <typename T, typename U>
+T& masked(const T& v, const U& m, T& out)
+{
+    return detail::compact(v, out, detail::select_by_mask(m), detail::use_compress<T>());
+}
 
-    return v1;
+template <typename T, typename U>
+T& masked(packed_bits_policy, const T& v, const U& m, T& out)
+{
+    return detail::compact(v, out, detail::select_by_packed_bits(m), detail::use_compress<T>());
 }
 
-template <typename T, typename U, typename... Ts>
-enable_if_t<(sizeof...(Ts) > 0),T&>
-intersect(T& v1, U&& v2, Ts&&... vs)
+/*
+ * Write the elements of v selected by m to d_first, and return the end of
+ * the output.
+ */
+template <typename T, typename U, typename OutputIt>
+OutputIt mask_copy(const T& v, const U& m, OutputIt d_first)
 {
-    intersect(v1, std::forward<U>(v2));
-    intersect(v1, std::forward<Ts>(vs)...);
-    return v1;
+    auto i2 = m.begin();
+    for (auto& x : v)
+    {
+        if (*i2++) *d_first++ = x;
+    }
+    return d_first;
 }
 
-template <typename T, typename... Ts>
-T intersection(T v1, Ts&&... vs)
+template <typename T, typename U, typename OutputIt>
+OutputIt mask_copy(packed_bits_policy, const T& v, const U& m, OutputIt d_first)
 {
-    intersect(v1, std::forward<Ts>(vs)...);
-    return v1;
+    auto sel = detail::select_by_packed_bits(m);
+    size_t i = 0;
+    for (auto& x : v)
+    {
+        if (sel(i++, x)) *d_first++ = x;
+    }
+    return d_first;
 }
 
-template <typename T>
-T& unite(T& v1, T v2)
+namespace detail
 {
-    T v3;
 
-    sort(v1);
-    sort(v2);
+/*
+ * Integral keys whose range [min,max] spans fewer than this many values, or
+ * fewer than dense_translate_ratio times the number of keys, are translated
+ * through a direct-mapped table; sparser ones go through a hash map.
+ */
+constexpr size_t dense_translate_span = 256;
+constexpr size_t dense_translate_ratio = 4;
+
+/*
+ * A pair of iterators with begin() and end(), for the translate maps,
+ * which work on ranges.
+ */
+template <typename Iterator>
+struct iterator_range
+{
+    Iterator first, last;
 
-    std::set_union(std::make_move_iterator(v1.begin()),
-                   std::make_move_iterator(v1.end()),
-                   std::make_move_iterator(v2.begin()),
-                   std::make_move_iterator(v2.end()),
-                   std::back_inserter(v3));
-    v1.swap(v3);
+    Iterator begin() const { return first; }
 
-    return v1;
+    Iterator end() const { return last; }
+};
+
+template <typename Key>
+struct translate_kind
+: std::integral_constant<int,std::is_integral<Key>::value &&
+                             !std::is_same<Key,bool>::value ? 2 :
+                             is_hashable<Key>::value ? 1 : 0> {};
+
+/*
+ * Whether the element l of another arithmetic type is exactly some key k,
+ * so that it is translated only if it compares equal to an entry of from.
+ */
+template <typename Key, typename V>
+bool exact_key(const V& l, Key& k, std::true_type)
+{
+    V lim = std::ldexp(V(1), std::numeric_limits<Key>::digits);
+    V lo = std::is_signed<Key>::value ? -lim : V(0);
+    if (!(l >= lo && l < lim)) return false;
+    k = Key(l);
+    return V(k) == l;
 }
 
-template <typename T, typename U, typename... Ts>
-enable_if_t<(sizeof...(Ts) > 0),T&>
-unite(T& v1, U&& v2, Ts&&... vs)
+template <typename Key, typename V>
+bool exact_key(const V& l, Key& k, std::false_type)
 {
-    unite(v1, std::forward<U>(v2));
-    unite(v1, std::forward<Ts>(vs)...);
-    return v1;
+    k = Key(l);
+    return V(k) == l;
 }
 
-template <typename T, typename... Ts>
-T union_of(T v1, Ts&&... vs)
+template <typename Key, typename V>
+bool exact_key(const V& l, Key& k)
 {
-    unite(v1, std::forward<Ts>(vs)...);
-    return v1;
+    return exact_key(l, k, std::integral_constant<bool,
+        std::is_floating_point<V>::value && std::is_integral<Key>::value>());
 }
 
-template <typename T>
-T& exclude(T& v1, T v2)
+template <typename Key, int Kind=translate_kind<Key>::value>
+class translate_map;
+
+/*
+ * Keys which can be neither tabulated nor hashed: binary search in a table
+ * of (key, replacement) pairs sorted by key.
+ */
+template <typename Key>
+class translate_map<Key,0>
+{
+    private:
+        typedef std::pair<Key,Key> entry;
+
+        std::vector<entry> map_;
+
+        static bool less(const entry& a, const entry& b)
+        {
+            return a.first < b.first;
+        }
+
+    public:
+        template <typename U>
+        translate_map(const U& from, const U& to)
+        {
+            size_t n = std::min(from.size(), to.size());
+            map_.reserve(n);
+            for (size_t i = 0;i < n;i++) map_.emplace_back(from[i], to[i]);
+
+            /*
+             * Keep the last replacement given for each key.
+             */
+            std::stable_sort(map_.begin(), map_.end(), less);
+            auto out = map_.begin();
+            for (auto it = map_.begin();it != map_.end();++it)
+            {
+                if (out != map_.begin() && !((out-1)->first < it->first))
+                    (out-1)->second = std::move(it->second);
+                else
+                {
+                    if (out != it) *out = std::move(*it);
+                    ++out;
+                }
+            }
+            map_.erase(out, map_.end());
+        }
+
+        template <typename T>
+        void apply(T& s) const
+        {
+            for (auto& l : s)
+            {
+                auto lb = std::lower_bound(map_.begin(), map_.end(), l,
+                [](const entry& e, const decay_t<decltype(l)>& x)
+                {
+                    return e.first < x;
+                });
+                if (lb != map_.end() && lb->first == l) l = lb->second;
+            }
+        }
+};
+
+template <typename Key>
+class translate_map<Key,1>
+{
+    private:
+        std::unordered_map<Key,Key> map_;
+
+    public:
+        translate_map() {}
+
+        template <typename U>
+        translate_map(const U& from, const U& to)
+        {
+            size_t n = std::min(from.size(), to.size());
+            map_.reserve(n);
+            for (size_t i = 0;i < n;i++) map_[from[i]] = to[i];
+        }
+
+        template <typename T>
+        void apply(T& s) const
+        {
+            typedef decay_t<decltype(*s.begin())> value_type;
+
+            if (map_.empty()) return;
+            apply(s, std::integral_constant<bool,
+                !std::is_same<value_type,Key>::value &&
+                std::is_arithmetic<value_type>::value &&
+                std::is_arithmetic<Key>::value>());
+        }
+
+    private:
+        template <typename T>
+        void apply(T& s, std::false_type) const
+        {
+            for (auto& l : s)
+            {
+                auto it = map_.find(l);
+                if (it != map_.end()) l = it->second;
+            }
+        }
+
+        template <typename T>
+        void apply(T& s, std::true_type) const
+        {
+            for (auto& l : s)
+            {
+                Key k;
+                if (!exact_key(l, k)) continue;
+                auto it = map_.find(k);
+                if (it != map_.end()) l = it->second;
+            }
+        }
+};
+
+/*
+ * Integral keys: a table indexed by key-min which maps every key in
+ * [min,max] to its replacement, or to itself if it has none, so that each
+ * element costs one range check and one load. Keys spread too thinly for
+ * a table use a hash map instead.
+ */
+template <typename Key>
+class translate_map<Key,2>
 {
-    sort(v1);
-    sort(v2);
+    private:
+        typedef std::make_unsigned_t<Key> ukey;
 
-    auto i1 = v1.begin();
-    auto i2 = v2.begin();
-    auto i3 = v1.begin();
-    while (i1 != v1.end() && i2 != v2.end())
-    {
-        if (*i1 < *i2)
+        Key min_ = Key();
+        Key max_ = Key();
+        std::vector<Key> table_;
+        translate_map<Key,1> sparse_;
+        bool dense_ = true;
+
+        template <typename T>
+        void apply_dense(T& s, std::true_type) const
         {
-            *i3 = std::move(*i1);
-            ++i1;
-            ++i3;
+            const Key* table = table_.data();
+            size_t span = table_.size();
+
+            for (auto& l : s)
+            {
+                size_t d = ukey(ukey(l) - ukey(min_));
+                if (d < span) l = table[d];
+            }
         }
-        else if (*i2 < *i1)
+
+        template <typename T>
+        void apply_dense(T& s, std::false_type) const
         {
-            ++i2;
+            const Key* table = table_.data();
+
+            for (auto& l : s)
+            {
+                Key k;
+                if (exact_key(l, k) && !(k < min_) && !(max_ < k))
+                    l = table[ukey(ukey(k) - ukey(min_))];
+            }
         }
-        else
+
+    public:
+        template <typename U>
+        translate_map(const U& from, const U& to)
         {
-            ++i1;
-            ++i2;
+            size_t n = std::min(from.size(), to.size());
+            if (n == 0) return;
+
+            auto range = std::minmax_element(from.begin(), from.begin()+n);
+            min_ = *range.first;
+            max_ = *range.second;
+
+            size_t d = ukey(ukey(max_) - ukey(min_));
+            if (d >= std::max(dense_translate_span, dense_translate_ratio*n))
+            {
+                dense_ = false;
+                sparse_ = translate_map<Key,1>(from, to);
+                return;
+            }
+
+            table_.resize(d+1);
+            for (size_t i = 0;i <= d;i++) table_[i] = Key(ukey(min_)+ukey(i));
+            for (size_t i = 0;i < n;i++)
+                table_[ukey(ukey(from[i]) - ukey(min_))] = to[i];
         }
-    }
-    i3 = std::move(i1, v1.end(), i3);
-    v1.erase(i3, v1.end());
 
-    return v1;
-}
+        template <typename T>
+        void apply(T& s) const
+        {
+            typedef decay_t<decltype(*s.begin())> value_type;
 
-template <typename T, typename U, typename... Ts>
-enable_if_t<(sizeof...(Ts) > 0),T&>
-exclude(T& v1, U&& v2, Ts&&... vs)
-{
-    exclude(v1, std::forward<U>(v2));
-    exclude(v1, std::forward<Ts>(vs)...);
-    return v1;
-}
+            if (!dense_) sparse_.apply(s);
+            else if (!table_.empty())
+                apply_dense(s, std::is_same<value_type,Key>());
+        }
+};
 
-template <typename T, typename... Ts>
-T exclusion(T v1, Ts&&... vs)
-{
-    exclude(v1, std::forward<Ts>(vs)...);
-    return v1;
 }
 
-template <typename T>
-T mutual_exclusion(T v1, T v2)
+/*
+ * A mapping from each element of from to the corresponding element of to,
+ * built once and applied to any number of containers with translate or
+ * translated. Small integral domains (including chars) use a
+ * direct-mapped table, other hashable keys a hash map, and the rest a
+ * sorted table. If from contains a key more than once, the last
+ * replacement given for it wins.
+ */
+template <typename Key>
+class translator
 {
-    T v3;
-    sort(v1);
-    sort(v2);
-    std::set_symmetric_difference(std::make_move_iterator(v1.begin()),
-                                  std::make_move_iterator(v1.end()),
-                                  std::make_move_iterator(v2.begin()),
-                                  std::make_move_iterator(v2.end()),
-                                  std::back_inserter(v3));
-    return v3;
-}
+    public:
+        typedef Key value_type;
 
-template <typename T, typename U>
-T& mask(T& v, const U& m)
-{
-    auto i1 = v.begin();
-    auto i2 = m.begin();
-    auto i3 = v.begin();
-    while (i1 != v.end())
-    {
-        if (*i2)
+        template <typename U>
+        translator(const U& from, const U& to) : map_(from, to) {}
+
+        template <typename T>
+        T& apply(T& s) const
         {
-            std::iter_swap(i1, i3);
-            ++i3;
+            map_.apply(s);
+            return s;
         }
-        ++i1;
-        ++i2;
-    }
 
-    v.resize(i3-v.begin());
-    return v;
+    private:
+        detail::translate_map<Key> map_;
+};
+
+template <typename U>
+translator<typename U::value_type> make_translator(const U& from, const U& to)
+{
+    return translator<typename U::value_type>(from, to);
 }
 
-template <typename T, typename U>
-T masked(T v, const U& m)
+template <typename T, typename Key>
+T& translate(T& s, const translator<Key>& trans)
 {
-    mask(v, m);
-    return v;
+    return trans.apply(s);
+}
+
+template <typename T, typename Key>
+T translated(T s, const translator<Key>& trans)
+{
+    trans.apply(s);
+    return s;
 }
 
 template <typename T, typename U>
 T& translate(T& s, U from, U to)
 {
-    cosort(from, to);
-
-    for (auto& l : s)
-    {
-        auto lb = lower_bound(from.begin(), from.end(), l);
-
-        if (lb != from.end() && *lb == l)
-        {
-            l = to[lb - from.begin()];
-        }
-    }
-
-    return s;
+    return make_translator(from, to).apply(s);
 }
 
 template <typename T, typename U>
@@ -662,6 +3195,42 @@ translated(T s, U&& from, U&& to)
     return s;
 }
 
+/*
+ * As translated(s, ...), but into the existing container out, reusing its
+ * storage.
+ */
+template <typename T, typename Key>
+T& translated(const T& s, const translator<Key>& trans, T& out)
+{
+    if (&out != &s) out.assign(s.begin(), s.end());
+    return trans.apply(out);
+}
+
+template <typename T, typename U>
+T& translated(const T& s, const U& from, const U& to, T& out)
+{
+    return translated(s, make_translator(from, to), out);
+}
+
+/*
+ * Write the translated elements of s to the forward range starting at
+ * d_first, and return its end.
+ */
+template <typename T, typename Key, typename ForwardIt>
+ForwardIt translate_copy(const T& s, const translator<Key>& trans, ForwardIt d_first)
+{
+    ForwardIt d_last = std::copy(s.begin(), s.end(), d_first);
+    detail::iterator_range<ForwardIt> out{d_first, d_last};
+    trans.apply(out);
+    return d_last;
+}
+
+template <typename T, typename U, typename ForwardIt>
+ForwardIt translate_copy(const T& s, const U& from, const U& to, ForwardIt d_first)
+{
+    return translate_copy(s, make_translator(from, to), d_first);
+}
+
 template <typename T, typename U>
 T permuted(const T& v, const U& p)
 {
@@ -670,32 +3239,132 @@ T permuted(const T& v, const U& p)
     return v2;
 }
 
+/*
+ * Rearrange v so that v[i] becomes the old v[p[i]]. p must be a
+ * permutation of [0,v.size()); the elements are moved in place.
+ */
 template <typename T, typename U>
 void permute(T& v, const U& p)
 {
-    v = permuted(v, p);
+    std::vector<size_t> index(p.begin(), p.end());
+    detail::apply_permutation(v.begin(), index.size(),
+                              [&index](size_t i) -> size_t& { return index[i]; });
 }
 
+/*
+ * The inverse of permuted: the result r has r[p[i]] == v[i].
+ */
 template <typename T, typename U>
 T unpermuted(const T& v, const U& p)
 {
+    std::vector<size_t> inv(v.size());
+    size_t j = 0;
+    for (auto& i : p) inv[i] = j++;
+
     T v2; v2.reserve(v.size());
-    for (size_t i = 0;i < v.size();i++)
-    {
-        size_t j = std::find(p.begin(), p.end(), i) - p.begin();
-        v2.push_back(v[j]);
-    }
+    for (size_t i = 0;i < v.size();i++) v2.push_back(v[inv[i]]);
     return v2;
 }
 
+/*
+ * The inverse of permute: v[p[i]] becomes the old v[i], in place.
+ */
 template <typename T, typename U>
 void unpermute(T& v, const U& p)
 {
-    v = unpermuted(v, p);
+    std::vector<size_t> inv(v.size());
+    size_t j = 0;
+    for (auto& i : p) inv[i] = j++;
+
+    detail::apply_permutation(v.begin(), inv.size(),
+                              [&inv](size_t i) -> size_t& { return inv[i]; });
 }
 
+namespace detail
+{
+
+template <typename T, typename=void>
+struct is_less_comparable : std::false_type {};
+
+template <typename T>
+struct is_less_comparable<T, enable_if_exists_t<decltype(std::declval<const T&>() <
+                                                         std::declval<const T&>())>>
+: std::true_type {};
+
+template <typename Value, bool Hashable=is_hashable<Value>::value>
+class position_map
+{
+    private:
+        std::unordered_map<Value,size_t> pos_;
+
+    public:
+        template <typename U>
+        explicit position_map(const U& s)
+        : pos_(s.size())
+        {
+            size_t i = 0;
+            for (auto& e : s) pos_.emplace(e, i++);
+        }
+
+        size_t find(const Value& m) const
+        {
+            auto it = pos_.find(m);
+            return it == pos_.end() ? size_t(-1) : it->second;
+        }
+
+        size_t size() const { return pos_.size(); }
+};
+
+template <typename Value>
+class position_map<Value,false>
+{
+    private:
+        std::vector<std::pair<Value,size_t>> pos_;
+
+        static bool less(const std::pair<Value,size_t>& a,
+                         const std::pair<Value,size_t>& b)
+        {
+            return a.first < b.first;
+        }
+
+    public:
+        template <typename U>
+        explicit position_map(const U& s)
+        {
+            pos_.reserve(s.size());
+            size_t i = 0;
+            for (auto& e : s) pos_.emplace_back(e, i++);
+
+            /*
+             * Keep the first position of each run of equal elements.
+             */
+            std::stable_sort(pos_.begin(), pos_.end(), less);
+            pos_.erase(std::unique(pos_.begin(), pos_.end(),
+                       [](const std::pair<Value,size_t>& a,
+                          const std::pair<Value,size_t>& b)
+                       {
+                           return !(a.first < b.first);
+                       }), pos_.end());
+        }
+
+        size_t find(const Value& m) const
+        {
+            auto it = std::lower_bound(pos_.begin(), pos_.end(),
+                                       std::pair<Value,size_t>(m, 0), less);
+            return it == pos_.end() || m < it->first ? size_t(-1) : it->second;
+        }
+
+        size_t size() const { return pos_.size(); }
+};
+
+/*
+ * select_from builds a select_index when match has more than this many
+ * elements, and otherwise searches s directly for each of them.
+ */
+constexpr size_t select_index_threshold = 8;
+
 template <typename T, typename U>
-T select_from(const T& v, const U& s, const U& match)
+T select_from(const T& v, const U& s, const U& match, std::false_type)
 {
     T v2; v2.reserve(match.size());
 
@@ -714,6 +3383,79 @@ T select_from(const T& v, const U& s, const U& match)
     return v2;
 }
 
+}
+
+/*
+ * The position of the first occurrence of each element of s, built once
+ * so that repeated select_from calls against the same s each cost
+ * O(|match|) instead of O(|match|*|s|). Elements are hashed if std::hash
+ * supports them and binary searched in a sorted table otherwise.
+ */
+template <typename U>
+class select_index
+{
+    public:
+        typedef typename U::value_type value_type;
+
+        static constexpr size_t npos = size_t(-1);
+
+        explicit select_index(const U& s) : map_(s) {}
+
+        /*
+         * The position in s of the first element equal to m, or npos.
+         */
+        size_t find(const value_type& m) const { return map_.find(m); }
+
+        /*
+         * The number of distinct elements of s.
+         */
+        size_t size() const { return map_.size(); }
+
+    private:
+        detail::position_map<value_type> map_;
+};
+
+template <typename U>
+constexpr size_t select_index<U>::npos;
+
+template <typename T, typename U>
+T select_from(const T& v, const select_index<U>& index, const U& match)
+{
+    T v2; v2.reserve(match.size());
+
+    for (auto& m : match)
+    {
+        size_t i = index.find(m);
+        if (i != select_index<U>::npos) v2.push_back(v[i]);
+    }
+
+    return v2;
+}
+
+namespace detail
+{
+
+template <typename T, typename U>
+T select_from(const T& v, const U& s, const U& match, std::true_type)
+{
+    if (match.size() <= select_index_threshold)
+        return select_from(v, s, match, std::false_type());
+
+    return stl_ext::select_from(v, select_index<U>(s), match);
+}
+
+}
+
+template <typename T, typename U>
+T select_from(const T& v, const U& s, const U& match)
+{
+    typedef typename U::value_type value_type;
+
+    return detail::select_from(v, s, match,
+        std::integral_constant<bool,detail::is_hashable<value_type>::value ||
+                                    detail::is_less_comparable<value_type>::value>());
+}
+
 template <typename T, typename U>
 T select_from(const T& v, const U& idx)
 {
@@ -722,44 +3464,227 @@ T select_from(const T& v, const U& idx)
     return v2;
 }
 
+namespace detail
+{
+
+template <typename U>
+auto append_size(const U& u, int) -> decltype(size_t(u.size()))
+{
+    return u.size();
+}
+
+template <typename U>
+size_t append_size(const U& u, long)
+{
+    return std::distance(u.begin(), u.end());
+}
+
+/*
+ * Make room for n more elements, growing at least geometrically so that
+ * repeated appends still take linear time.
+ */
+template <typename T>
+auto reserve_append(T& t, size_t n, int) -> decltype(void(t.reserve(n)))
+{
+    size_t size = t.size()+n;
+    if (size > t.capacity()) t.reserve(std::max(size, 2*t.capacity()));
+}
+
+template <typename T>
+void reserve_append(T&, size_t, long) {}
+
+/*
+ * Ranges whose elements can be appended to T as one block of memory.
+ */
+template <typename T, typename U>
+struct use_memcpy_append
+: std::integral_constant<bool, is_contiguous<U>::value &&
+                               std::is_same<typename T::value_type,typename U::value_type>::value &&
+                               std::is_trivially_copyable<typename T::value_type>::value> {};
+
 template <typename T, typename U>
-void append(T& t, const U& u)
+void append_range(T& t, U&& u, std::true_type)
 {
-    t.insert(t.end(), u.begin(), u.end());
+    auto p = u.data();
+    t.insert(t.end(), p, p+u.size());
 }
 
 template <typename T, typename U>
-void append(T& t, U&& u)
+void append_range(T& t, U&& u, std::false_type)
 {
-    t.insert(t.end(), std::make_move_iterator(u.begin()),
-                      std::make_move_iterator(u.end()));
+    typedef decltype(u.begin()) iterator;
+    typedef conditional_t<std::is_lvalue_reference<U>::value,iterator,
+                          std::move_iterator<iterator>> source;
+    t.insert(t.end(), source(u.begin()), source(u.end()));
 }
 
-template <typename T, typename U, typename V, typename... W>
-void append(T& t, U&& u, V&& v, W&&... w)
+}
+
+/*
+ * Append the elements of each of u... to t in order, reserving space for
+ * all of them at once. The elements of rvalues are moved, and those of
+ * lvalues copied.
+ */
+template <typename T, typename... U>
+T& append(T& t, U&&... u)
 {
-    append(t, std::forward<U&&>(u));
-    append(t, std::forward<V&&>(v), std::forward<W&&>(w)...);
+    size_t sizes[] = {0, detail::append_size(u, 0)...};
+    size_t n = 0;
+    for (size_t size : sizes) n += size;
+    detail::reserve_append(t, n, 0);
+
+    int expand[] = {0, (detail::append_range(t, std::forward<U>(u),
+                            detail::use_memcpy_append<T,decay_t<U>>()), 0)...};
+    (void)expand;
+    return t;
 }
 
 template <typename T, typename... U>
 T appended(T t, U&&... u)
 {
-    append(t, std::forward<U&&>(u)...);
+    append(t, std::forward<U>(u)...);
     return t;
 }
 
+namespace detail
+{
+
+/*
+ * The container returned by map(func, v): T itself if func returns its
+ * element type, and a std::vector of the result type otherwise.
+ */
+template <typename Functor, typename T>
+struct map_result
+{
+    typedef std::decay_t<decltype(*std::declval<const T&>().begin())> R;
+    typedef std::decay_t<decltype(std::declval<Functor&>()(
+        *std::declval<const T&>().begin()))> S;
+    typedef std::conditional_t<std::is_same<R,S>::value,T,std::vector<S>> type;
+};
+
+template <typename Functor, typename T>
+using map_result_t = typename map_result<Functor,T>::type;
+
+/*
+ * Parallel maps give each thread at least this many elements.
+ */
+constexpr size_t parallel_map_chunk = 4096;
+
+/*
+ * Containers which parallel maps write from several threads at once:
+ * random-access ones, except those of bool, whose neighbouring elements
+ * may share storage.
+ */
+template <typename T>
+using use_parallel_map =
+    std::integral_constant<bool, is_random_access<T>::value &&
+                                 !std::is_same<typename T::value_type,bool>::value>;
+
+template <typename T, typename Functor>
+void transform(const parallel_policy& policy, T& v, Functor& func, std::true_type)
+{
+    auto first = v.begin();
+    parallel_for(policy, v.size(), parallel_map_chunk,
+    [&](size_t, size_t b, size_t e)
+    {
+        for (auto i = first+b;i != first+e;++i) *i = func(*i);
+    });
+}
+
+template <typename T, typename Functor>
+void transform(const parallel_policy&, T& v, Functor& func, std::false_type)
+{
+    for (auto&& e : v) e = func(e);
+}
+
+template <typename Functor, typename T>
+map_result_t<Functor,T> map(const parallel_policy& policy, Functor& func,
+                            const T& v, std::true_type)
+{
+    map_result_t<Functor,T> v2(v.size());
+
+    auto in = v.begin();
+    auto out = v2.begin();
+    parallel_for(policy, v.size(), parallel_map_chunk,
+    [&](size_t, size_t b, size_t e)
+    {
+        for (size_t i = b;i < e;i++) out[i] = func(in[i]);
+    });
+
+    return v2;
+}
+
+template <typename Functor, typename T>
+map_result_t<Functor,T> map(const parallel_policy&, Functor& func,
+                            const T& v, std::false_type)
+{
+    map_result_t<Functor,T> v2(v.size());
+    std::transform(v.begin(), v.end(), v2.begin(), func);
+    return v2;
+}
+
+}
+
 template <typename Functor, typename T>
 auto map(Functor&& func, const T& v)
 {
-    typedef std::decay_t<decltype(*v.begin())> R;
-    typedef std::decay_t<decltype(func(*v.begin()))> S;
-    typedef std::conditional_t<std::is_same<R,S>::value,T,std::vector<S>> U;
-    U v2; v2.reserve(v.size());
+    detail::map_result_t<Functor,T> v2; v2.reserve(v.size());
     for (auto& e : v) v2.push_back(func(e));
     return v2;
 }
 
+/*
+ * Maps which return the element type reuse the storage of an rvalue input.
+ */
+template <typename Functor, typename T>
+enable_if_t<!std::is_reference<T>::value &&
+            std::is_same<detail::map_result_t<Functor,T>,T>::value, T>
+map(Functor&& func, T&& v)
+{
+    for (auto&& e : v) e = func(e);
+    return std::move(v);
+}
+
+/*
+ * Replace each element e of v by func(e).
+ */
+template <typename T, typename Functor>
+T& transform(T& v, Functor&& func)
+{
+    for (auto&& e : v) e = func(e);
+    return v;
+}
+
+/*
+ * Parallel maps size the result once and fill disjoint chunks of it from
+ * each thread, so func must be safe to call concurrently. The result type
+ * must be default-constructible.
+ */
+template <typename T, typename Functor>
+T& transform(const parallel_policy& policy, T& v, Functor&& func)
+{
+    detail::transform(policy, v, func, detail::use_parallel_map<T>());
+    return v;
+}
+
+template <typename Functor, typename T>
+auto map(const parallel_policy& policy, Functor&& func, const T& v)
+{
+    typedef detail::map_result_t<Functor,T> U;
+    return detail::map(policy, func, v,
+        std::integral_constant<bool, detail::use_parallel_map<T>::value &&
+                                     detail::use_parallel_map<U>::value>());
+}
+
+template <typename Functor, typename T>
+enable_if_t<!std::is_reference<T>::value &&
+            std::is_same<detail::map_result_t<Functor,T>,T>::value, T>
+map(const parallel_policy& policy, Functor&& func, T&& v)
+{
+    transform(policy, v, func);
+    return std::move(v);
+}
+
 }
 
 #endif
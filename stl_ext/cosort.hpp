@@ -2,11 +2,31 @@
 #define _STL_EXT_COSORT_HPP_
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+#include "type_traits.hpp"
 
 namespace stl_ext
 {
 
+/*
+ * Tag selecting the cosort which sorts (key, index) pairs and then moves
+ * each value once into place. This is chosen automatically for large
+ * value types but may be requested explicitly.
+ */
+struct indirect_policy {};
+
+constexpr indirect_policy indirect;
+
 namespace detail
 {
 
@@ -377,38 +397,839 @@ class coiterator
 template <class key_iterator, class val_iterator, class Comparator>
 class cocomparator
 {
-    typedef typename coiterator<key_iterator,val_iterator>::value_type val;
-
     Comparator comp_;
 
     public:
         cocomparator(Comparator comp) : comp_(comp) {}
 
-        bool operator()(const val& r1, const val& r2) const
+        /*
+         * Accept any mix of doublet<T,U> and doublet<T&,U&> so that
+         * comparisons never copy the elements.
+         */
+        template <class R1, class R2>
+        bool operator()(const R1& r1, const R2& r2) const
         {
             return comp_(r1.first, r2.first);
         }
 };
 
+/*
+ * N-column analogues of doublet<T,U> and doublet<T&,U&>, used to sort any
+ * number of parallel ranges by the first one.
+ */
+template <typename... Ts> struct tuplet_ref;
+
+template <typename... Ts>
+struct tuplet
+{
+    std::tuple<Ts...> values;
+
+    tuplet(const tuplet&) = default;
+
+    tuplet(tuplet&&) = default;
+
+    tuplet(const tuplet_ref<Ts...>& other) : values(other.values) {}
+
+    tuplet(tuplet_ref<Ts...>&& other)
+    : tuplet(std::move(other), std::index_sequence_for<Ts...>()) {}
+
+    tuplet& operator=(const tuplet&) = default;
+
+    tuplet& operator=(tuplet&&) = default;
+
+    private:
+        template <size_t... I>
+        tuplet(tuplet_ref<Ts...>&& other, std::index_sequence<I...>)
+        : values(std::move(std::get<I>(other.values))...) {}
+};
+
+template <typename... Ts>
+struct tuplet_ref
+{
+    std::tuple<Ts&...> values;
+
+    tuplet_ref(Ts&... values_) : values(values_...) {}
+
+    tuplet_ref(const tuplet_ref&) = default;
+
+    tuplet_ref& operator=(const tuplet_ref& other)
+    {
+        values = other.values;
+        return *this;
+    }
+
+    tuplet_ref& operator=(tuplet_ref&& other)
+    {
+        move_from(other, std::index_sequence_for<Ts...>());
+        return *this;
+    }
+
+    tuplet_ref& operator=(const tuplet<Ts...>& other)
+    {
+        values = other.values;
+        return *this;
+    }
+
+    tuplet_ref& operator=(tuplet<Ts...>&& other)
+    {
+        values = std::move(other.values);
+        return *this;
+    }
+
+    friend void swap(tuplet_ref lhs, tuplet_ref rhs)
+    {
+        lhs.swap_with(rhs, std::index_sequence_for<Ts...>());
+    }
+
+    private:
+        template <size_t... I>
+        void move_from(tuplet_ref& other, std::index_sequence<I...>)
+        {
+            int expand[] = {0, (std::get<I>(values) = std::move(std::get<I>(other.values)), 0)...};
+            (void)expand;
+        }
+
+        template <size_t... I>
+        void swap_with(tuplet_ref& other, std::index_sequence<I...>)
+        {
+            using std::swap;
+            int expand[] = {0, (swap(std::get<I>(values), std::get<I>(other.values)), 0)...};
+            (void)expand;
+        }
+};
+
+template <typename... Its>
+class multi_coiterator
+{
+    std::tuple<Its...> its_;
+
+    public:
+        typedef tuplet<typename std::iterator_traits<Its>::value_type...> value_type;
+        typedef ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef tuplet_ref<typename std::iterator_traits<Its>::value_type...> reference;
+        typedef std::random_access_iterator_tag iterator_category;
+
+        multi_coiterator(const Its&... its) : its_(its...) {}
+
+        bool operator==(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) == std::get<0>(other.its_);
+        }
+
+        bool operator!=(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) != std::get<0>(other.its_);
+        }
+
+        bool operator<(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) < std::get<0>(other.its_);
+        }
+
+        bool operator>(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) > std::get<0>(other.its_);
+        }
+
+        bool operator<=(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) <= std::get<0>(other.its_);
+        }
+
+        bool operator>=(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_) >= std::get<0>(other.its_);
+        }
+
+        reference operator*() const
+        {
+            return at(0, std::index_sequence_for<Its...>());
+        }
+
+        reference operator[](ptrdiff_t n) const
+        {
+            return at(n, std::index_sequence_for<Its...>());
+        }
+
+        multi_coiterator& operator++()
+        {
+            return *this += 1;
+        }
+
+        multi_coiterator& operator--()
+        {
+            return *this -= 1;
+        }
+
+        multi_coiterator operator++(int)
+        {
+            multi_coiterator old(*this);
+            ++*this;
+            return old;
+        }
+
+        multi_coiterator operator--(int)
+        {
+            multi_coiterator old(*this);
+            --*this;
+            return old;
+        }
+
+        multi_coiterator& operator+=(ptrdiff_t n)
+        {
+            advance(n, std::index_sequence_for<Its...>());
+            return *this;
+        }
+
+        multi_coiterator& operator-=(ptrdiff_t n)
+        {
+            advance(-n, std::index_sequence_for<Its...>());
+            return *this;
+        }
+
+        multi_coiterator operator+(ptrdiff_t n) const
+        {
+            return advanced(n, std::index_sequence_for<Its...>());
+        }
+
+        friend multi_coiterator operator+(ptrdiff_t n, const multi_coiterator& other)
+        {
+            return other+n;
+        }
+
+        multi_coiterator operator-(ptrdiff_t n) const
+        {
+            return advanced(-n, std::index_sequence_for<Its...>());
+        }
+
+        ptrdiff_t operator-(const multi_coiterator& other) const
+        {
+            return std::get<0>(its_)-std::get<0>(other.its_);
+        }
+
+    private:
+        template <size_t... I>
+        multi_coiterator advanced(ptrdiff_t n, std::index_sequence<I...>) const
+        {
+            return multi_coiterator((std::get<I>(its_)+n)...);
+        }
+
+        template <size_t... I>
+        void advance(ptrdiff_t n, std::index_sequence<I...>)
+        {
+            int expand[] = {0, (std::get<I>(its_) += n, 0)...};
+            (void)expand;
+        }
+
+        template <size_t... I>
+        reference at(ptrdiff_t n, std::index_sequence<I...>) const
+        {
+            return reference(std::get<I>(its_)[n]...);
+        }
+};
+
+template <class Comparator>
+class multi_cocomparator
+{
+    Comparator comp_;
+
+    public:
+        multi_cocomparator(Comparator comp) : comp_(comp) {}
+
+        template <class R1, class R2>
+        bool operator()(const R1& r1, const R2& r2) const
+        {
+            return comp_(std::get<0>(r1.values), std::get<0>(r2.values));
+        }
+};
+
+template <typename T, typename=void>
+struct is_range : std::false_type {};
+
+template <typename T>
+struct is_range<T, enable_if_exists_t<decltype(std::declval<T&>().begin())>>
+: std::true_type {};
+
+template <typename... Ts>
+struct are_ranges;
+
+template <>
+struct are_ranges<> : std::true_type {};
+
+template <typename T, typename... Ts>
+struct are_ranges<T, Ts...>
+: std::integral_constant<bool,is_range<T>::value && are_ranges<Ts...>::value> {};
+
+template <typename T, typename... Ts>
+struct last_type : last_type<Ts...> {};
+
+template <typename T>
+struct last_type<T> { typedef T type; };
+
+template <typename... Ts>
+using last_type_t = typename last_type<Ts...>::type;
+
+/*
+ * Order-preserving map from a key to an unsigned integer, for the keys
+ * which can be radix sorted.
+ */
+template <typename Key, typename=void>
+struct radix_key : std::false_type {};
+
+template <typename Key>
+struct radix_key<Key, enable_if_t<is_integral<Key>::value &&
+                                  !is_same<Key,bool>::value>>
+: std::true_type
+{
+    typedef typename std::make_unsigned<Key>::type type;
+
+    static type flip()
+    {
+        return std::is_signed<Key>::value ? type(1) << (8*sizeof(type)-1) : 0;
+    }
+
+    static type encode(Key k)
+    {
+        return type(k)^flip();
+    }
+
+    static Key decode(type u)
+    {
+        return Key(type(u^flip()));
+    }
+};
+
+template <typename Key>
+struct radix_key<Key, enable_if_t<is_floating_point<Key>::value &&
+                                  std::numeric_limits<Key>::is_iec559 &&
+                                  (sizeof(Key) == 4 || sizeof(Key) == 8)>>
+: std::true_type
+{
+    typedef conditional_t<sizeof(Key) == 4, uint32_t, uint64_t> type;
+
+    static type sign()
+    {
+        return type(1) << (8*sizeof(type)-1);
+    }
+
+    static type encode(Key k)
+    {
+        type u;
+        std::memcpy(&u, &k, sizeof(u));
+        return (u & sign()) ? ~u : (u | sign());
+    }
+
+    static Key decode(type u)
+    {
+        u = (u & sign()) ? (u ^ sign()) : ~u;
+        Key k;
+        std::memcpy(&k, &u, sizeof(u));
+        return k;
+    }
+};
+
+/*
+ * 1 if the comparator sorts in ascending order of the key, -1 if it sorts
+ * in descending order, 0 if it is unknown.
+ */
+template <typename Comparator, typename Key>
+struct radix_order : std::integral_constant<int,0> {};
+
+template <typename Key>
+struct radix_order<std::less<Key>,Key> : std::integral_constant<int,1> {};
+
+template <typename Key>
+struct radix_order<std::less<void>,Key> : std::integral_constant<int,1> {};
+
+template <typename Key>
+struct radix_order<std::greater<Key>,Key> : std::integral_constant<int,-1> {};
+
+template <typename Key>
+struct radix_order<std::greater<void>,Key> : std::integral_constant<int,-1> {};
+
+/*
+ * Rearrange [first,first+n) so that position i receives the element which
+ * was at position index_of(i), following each cycle of the permutation so
+ * that every element is moved only once. index_of(i) must return a mutable
+ * reference; the permutation is reset to the identity on return.
+ */
+template <class iterator, class IndexOf>
+void apply_permutation(iterator first, size_t n, IndexOf&& index_of)
+{
+    for (size_t i = 0;i < n;i++)
+    {
+        if (size_t(index_of(i)) == i) continue;
+
+        auto tmp = std::move(first[i]);
+        size_t j = i;
+        for (size_t k = index_of(j);k != i;k = index_of(j))
+        {
+            first[j] = std::move(first[k]);
+            index_of(j) = j;
+            j = k;
+        }
+        first[j] = std::move(tmp);
+        index_of(j) = j;
+    }
+}
+
+/*
+ * What travels with each key through the radix passes: small trivially
+ * copyable values are carried directly, anything else is represented by
+ * its original position and gathered once at the end.
+ */
+template <class val_iterator>
+struct radix_value_payload
+{
+    typedef typename std::iterator_traits<val_iterator>::value_type type;
+
+    static type load(val_iterator vals, size_t i)
+    {
+        return vals[i];
+    }
+
+    template <typename Entry>
+    static void store(val_iterator vals, Entry* entries, size_t n)
+    {
+        for (size_t i = 0;i < n;i++) vals[i] = entries[i].payload;
+    }
+};
+
+template <typename Index, class val_iterator>
+struct radix_index_payload
+{
+    typedef Index type;
+
+    static type load(val_iterator, size_t i)
+    {
+        return Index(i);
+    }
+
+    template <typename Entry>
+    static void store(val_iterator vals, Entry* entries, size_t n)
+    {
+        apply_permutation(vals, n,
+                          [entries](size_t i) -> Index& { return entries[i].payload; });
+    }
+};
+
+/*
+ * Stable LSD radix sort of the encoded keys together with their payloads,
+ * one byte per pass. Passes in which every key has the same digit are
+ * skipped.
+ */
+template <class Payload, bool Descending, class key_iterator, class val_iterator>
+void radix_cosort(key_iterator keys_begin, size_t n, val_iterator vals_begin)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    typedef radix_key<key_type> traits;
+    typedef typename traits::type radix_type;
+    constexpr int npass = sizeof(radix_type);
+
+    struct entry
+    {
+        radix_type key;
+        typename Payload::type payload;
+    };
+
+    std::vector<entry> buf(n), scratch(n);
+    std::vector<size_t> counts(npass*256);
+
+    for (size_t i = 0;i < n;i++)
+    {
+        radix_type u = traits::encode(keys_begin[i]);
+        if (Descending) u = ~u;
+        buf[i].key = u;
+        buf[i].payload = Payload::load(vals_begin, i);
+        for (int p = 0;p < npass;p++) counts[256*p + ((u >> 8*p) & 0xff)]++;
+    }
+
+    entry* from = buf.data();
+    entry* to = scratch.data();
+
+    for (int p = 0;p < npass;p++)
+    {
+        size_t* count = &counts[256*p];
+        if (count[(from[0].key >> 8*p) & 0xff] == n) continue;
+
+        size_t offset = 0;
+        for (int d = 0;d < 256;d++)
+        {
+            size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0;i < n;i++)
+            to[count[(from[i].key >> 8*p) & 0xff]++] = from[i];
+
+        std::swap(from, to);
+    }
+
+    for (size_t i = 0;i < n;i++)
+    {
+        radix_type u = from[i].key;
+        if (Descending) u = ~u;
+        keys_begin[i] = traits::decode(u);
+    }
+
+    Payload::store(vals_begin, from, n);
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void comparison_cosort(key_iterator keys_begin, key_iterator keys_end,
+                       val_iterator vals_begin, Comparator comp)
+{
+    coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
+    std::sort(begin, begin+(keys_end-keys_begin),
+              cocomparator<key_iterator,val_iterator,Comparator>(comp));
+}
+
+/*
+ * Sort (key, original position) pairs and then move each value directly
+ * to its final place, so that values are never swapped during the sort.
+ */
+template <typename Index, class key_iterator, class val_iterator, class Comparator>
+void indirect_cosort(key_iterator keys_begin, size_t n,
+                     val_iterator vals_begin, Comparator comp)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+
+    struct entry
+    {
+        key_type key;
+        Index payload;
+    };
+
+    std::vector<entry> entries;
+    entries.reserve(n);
+    for (size_t i = 0;i < n;i++)
+        entries.push_back(entry{std::move(keys_begin[i]), Index(i)});
+
+    std::sort(entries.begin(), entries.end(),
+    [&comp](const entry& e1, const entry& e2)
+    {
+        return comp(e1.key, e2.key);
+    });
+
+    for (size_t i = 0;i < n;i++) keys_begin[i] = std::move(entries[i].key);
+
+    apply_permutation(vals_begin, n,
+                      [&entries](size_t i) -> Index& { return entries[i].payload; });
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void indirect_cosort(key_iterator keys_begin, key_iterator keys_end,
+                     val_iterator vals_begin, Comparator comp)
+{
+    size_t n = keys_end-keys_begin;
+
+    if (n <= std::numeric_limits<uint32_t>::max())
+    {
+        indirect_cosort<uint32_t>(keys_begin, n, vals_begin, comp);
+    }
+    else
+    {
+        indirect_cosort<size_t>(keys_begin, n, vals_begin, comp);
+    }
+}
+
+/*
+ * Values larger than this are sorted by index rather than swapped along
+ * with their keys.
+ */
+constexpr size_t max_direct_value_size = 256;
+
+template <class key_iterator, class val_iterator, class Comparator>
+void serial_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp, std::false_type)
+{
+    typedef typename std::iterator_traits<val_iterator>::value_type val_type;
+
+    if (sizeof(val_type) > max_direct_value_size && keys_end-keys_begin > 16)
+    {
+        indirect_cosort(keys_begin, keys_end, vals_begin, comp);
+    }
+    else
+    {
+        comparison_cosort(keys_begin, keys_end, vals_begin, comp);
+    }
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void radix_cosort(key_iterator keys_begin, key_iterator keys_end,
+                  val_iterator vals_begin, Comparator)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    constexpr bool descending = radix_order<Comparator,key_type>::value < 0;
+
+    typedef typename std::iterator_traits<val_iterator>::value_type val_type;
+    constexpr bool carry = std::is_trivially_copyable<val_type>::value &&
+                           sizeof(val_type) <= sizeof(uint64_t);
+    typedef conditional_t<carry, radix_value_payload<val_iterator>,
+                          radix_index_payload<uint32_t,val_iterator>> small_payload;
+
+    size_t n = keys_end-keys_begin;
+
+    if (carry || n <= std::numeric_limits<uint32_t>::max())
+    {
+        radix_cosort<small_payload,descending>(keys_begin, n, vals_begin);
+    }
+    else
+    {
+        radix_cosort<radix_index_payload<size_t,val_iterator>,descending>(keys_begin, n, vals_begin);
+    }
+}
+
+/*
+ * Below this size a comparison sort beats the radix sort, whose cost is
+ * dominated by clearing and scanning 256 counters per key byte.
+ */
+template <typename Key>
+constexpr ptrdiff_t min_radix_cosort_size()
+{
+    return 256*sizeof(typename radix_key<Key>::type);
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void serial_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp, std::true_type)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+
+    if (keys_end-keys_begin < min_radix_cosort_size<key_type>())
+    {
+        serial_cosort(keys_begin, keys_end, vals_begin, comp, std::false_type());
+    }
+    else
+    {
+        radix_cosort(keys_begin, keys_end, vals_begin, comp);
+    }
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void stable_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp, std::false_type)
+{
+    coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
+    std::stable_sort(begin, begin+(keys_end-keys_begin),
+                     cocomparator<key_iterator,val_iterator,Comparator>(comp));
+}
+
+/*
+ * -0.0 and +0.0 compare equal but encode differently, so the radix sort
+ * would not keep them in their input order.
+ */
+template <class key_iterator>
+bool has_negative_zero(key_iterator first, key_iterator last, std::true_type)
+{
+    for (;first != last;++first)
+        if (*first == 0 && std::signbit(*first)) return true;
+    return false;
+}
+
+template <class key_iterator>
+bool has_negative_zero(key_iterator, key_iterator, std::false_type)
+{
+    return false;
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void stable_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp, std::true_type)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+
+    if (keys_end-keys_begin < min_radix_cosort_size<key_type>() ||
+        has_negative_zero(keys_begin, keys_end, is_floating_point<key_type>()))
+    {
+        stable_cosort(keys_begin, keys_end, vals_begin, comp, std::false_type());
+    }
+    else
+    {
+        radix_cosort(keys_begin, keys_end, vals_begin, comp);
+    }
+}
+
+template <class Key, class Comparator>
+using use_radix_cosort =
+    std::integral_constant<bool,radix_key<Key>::value &&
+                                radix_order<Comparator,Key>::value != 0>;
+
+/*
+ * Sort with the LSD radix sort when the key type and comparator allow it,
+ * and with std::sort otherwise.
+ */
+template <class key_iterator, class val_iterator, class Comparator>
+void serial_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    serial_cosort(keys_begin, keys_end, vals_begin, comp,
+                  use_radix_cosort<key_type,Comparator>());
+}
+
+/*
+ * The radix sort is stable, so it serves for stable_cosort too, unless
+ * the keys hold both zeros.
+ */
+template <class key_iterator, class val_iterator, class Comparator>
+void stable_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, Comparator comp)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    stable_cosort(keys_begin, keys_end, vals_begin, comp,
+                  use_radix_cosort<key_type,Comparator>());
+}
+
+/*
+ * Sort nchunk pieces of the range concurrently and then merge neighbouring
+ * runs pairwise, with the merges of each round also run concurrently.
+ */
+template <class key_iterator, class val_iterator, class Comparator>
+void parallel_cosort(const parallel_policy& policy,
+                     key_iterator keys_begin, key_iterator keys_end,
+                     val_iterator vals_begin, Comparator comp)
+{
+    typedef coiterator<key_iterator,val_iterator> iterator;
+    cocomparator<key_iterator,val_iterator,Comparator> cocomp(comp);
+
+    iterator begin(keys_begin, vals_begin);
+    size_t n = keys_end-keys_begin;
+    size_t nchunk = num_chunks(policy, n, 1 << 14);
+
+    if (nchunk <= 1)
+    {
+        serial_cosort(keys_begin, keys_end, vals_begin, comp);
+        return;
+    }
+
+    std::vector<size_t> bounds(nchunk+1);
+    for (size_t i = 0;i <= nchunk;i++) bounds[i] = chunk_begin(n, nchunk, i);
+
+    parallel_chunks(nchunk, n,
+    [&](size_t, size_t from, size_t to)
+    {
+        serial_cosort(keys_begin+from, keys_begin+to, vals_begin+from, comp);
+    });
+
+    for (size_t width = 1;width < nchunk;width *= 2)
+    {
+        size_t nmerge = (nchunk+2*width-1)/(2*width);
+        parallel_chunks(nmerge, nmerge,
+        [&](size_t i, size_t, size_t)
+        {
+            size_t lo = 2*width*i;
+            size_t mid = std::min(lo+width, nchunk);
+            size_t hi = std::min(lo+2*width, nchunk);
+            if (mid == hi) return;
+            std::inplace_merge(begin+bounds[lo], begin+bounds[mid],
+                               begin+bounds[hi], cocomp);
+        });
+    }
+}
+
+template <class Comparator, class key_iterator, class... val_iterators>
+void multi_cosort(Comparator comp, std::false_type,
+                  key_iterator keys_begin, key_iterator keys_end,
+                  val_iterators... vals_begin)
+{
+    multi_coiterator<key_iterator,val_iterators...> begin(keys_begin, vals_begin...);
+    std::sort(begin, begin+(keys_end-keys_begin),
+              multi_cocomparator<Comparator>(comp));
+}
+
+/*
+ * For radix-sortable keys, sort the keys together with their positions and
+ * then move every column into place with one in-place permutation each.
+ */
+template <class Comparator, class key_iterator, class... val_iterators>
+void multi_cosort(Comparator comp, std::true_type,
+                  key_iterator keys_begin, key_iterator keys_end,
+                  val_iterators... vals_begin)
+{
+    size_t n = keys_end-keys_begin;
+
+    std::vector<size_t> perm(n);
+    for (size_t i = 0;i < n;i++) perm[i] = i;
+    serial_cosort(keys_begin, keys_end, perm.begin(), comp);
+
+    std::vector<size_t> tmp;
+    int expand[] = {0, (tmp = perm,
+                        apply_permutation(vals_begin, n,
+                            [&tmp](size_t i) -> size_t& { return tmp[i]; }),
+                        0)...};
+    (void)expand;
+}
+
+/*
+ * Split (columns..., comp) into the columns and the trailing comparator.
+ */
+template <class Keys, class Values, class Args, size_t... I>
+void multi_cosort(Keys& keys, Values& values, Args&& args,
+                  std::index_sequence<I...>)
+{
+    typedef decay_t<decltype(*keys.begin())> key_type;
+    auto comp = std::get<sizeof...(I)>(args);
+    multi_cosort(comp, use_radix_cosort<key_type,decltype(comp)>(),
+                 keys.begin(), keys.end(), values.begin(),
+                 std::get<I>(args).begin()...);
+}
+
 }
 
 template <class key_iterator, class val_iterator>
 void cosort(key_iterator keys_begin, key_iterator keys_end,
-            val_iterator vals_begin, val_iterator vals_end)
+            val_iterator vals_begin, val_iterator /*vals_end*/)
 {
-    detail::coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
-    detail::coiterator<key_iterator,val_iterator> end  (keys_end  , vals_end  );
-    std::sort(begin, end);
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    detail::serial_cosort(keys_begin, keys_end, vals_begin, std::less<key_type>());
 }
 
 template <class key_iterator, class val_iterator, class Comparator>
 void cosort(key_iterator keys_begin, key_iterator keys_end,
-            val_iterator vals_begin, val_iterator vals_end,
+            val_iterator vals_begin, val_iterator /*vals_end*/,
             Comparator comp)
 {
-    detail::coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
-    detail::coiterator<key_iterator,val_iterator> end  (keys_end  , vals_end  );
-    std::sort(begin, end, detail::cocomparator<key_iterator,val_iterator,Comparator>(comp));
+    detail::serial_cosort(keys_begin, keys_end, vals_begin, comp);
+}
+
+template <class key_iterator, class val_iterator>
+void cosort(const indirect_policy&,
+            key_iterator keys_begin, key_iterator keys_end,
+            val_iterator vals_begin, val_iterator /*vals_end*/)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    detail::indirect_cosort(keys_begin, keys_end, vals_begin, std::less<key_type>());
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void cosort(const indirect_policy&,
+            key_iterator keys_begin, key_iterator keys_end,
+            val_iterator vals_begin, val_iterator /*vals_end*/,
+            Comparator comp)
+{
+    detail::indirect_cosort(keys_begin, keys_end, vals_begin, comp);
+}
+
+template <class key_iterator, class val_iterator>
+void cosort(const parallel_policy& policy,
+            key_iterator keys_begin, key_iterator keys_end,
+            val_iterator vals_begin, val_iterator /*vals_end*/)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    detail::parallel_cosort(policy, keys_begin, keys_end, vals_begin,
+                            std::less<key_type>());
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void cosort(const parallel_policy& policy,
+            key_iterator keys_begin, key_iterator keys_end,
+            val_iterator vals_begin, val_iterator /*vals_end*/,
+            Comparator comp)
+{
+    detail::parallel_cosort(policy, keys_begin, keys_end, vals_begin, comp);
 }
 
 template <class Keys, class Values>
@@ -418,11 +1239,172 @@ void cosort(Keys& keys, Values& values)
 }
 
 template <class Keys, class Values, class Comparator>
-void cosort(Keys& keys, Values& values, Comparator comp)
+enable_if_t<!detail::is_range<Comparator>::value>
+cosort(Keys& keys, Values& values, Comparator comp)
 {
     cosort(keys.begin(), keys.end(), values.begin(), values.end(), comp);
 }
 
+template <class Keys, class Values, class... Columns>
+enable_if_t<(sizeof...(Columns) > 0) &&
+            detail::are_ranges<Keys, Values, Columns...>::value>
+cosort(Keys& keys, Values& values, Columns&... columns)
+{
+    typedef decay_t<decltype(*keys.begin())> key_type;
+    typedef std::less<key_type> comparator;
+    typedef std::integral_constant<bool,detail::radix_key<key_type>::value> use_radix;
+    detail::multi_cosort(comparator(), use_radix(), keys.begin(), keys.end(),
+                         values.begin(), columns.begin()...);
+}
+
+template <class Keys, class Values, class... Args>
+enable_if_t<(sizeof...(Args) > 1) &&
+            !detail::is_range<decay_t<detail::last_type_t<Args...>>>::value>
+cosort(Keys& keys, Values& values, Args&&... args)
+{
+    detail::multi_cosort(keys, values,
+                         std::forward_as_tuple(std::forward<Args>(args)...),
+                         std::make_index_sequence<sizeof...(Args)-1>());
+}
+
+template <class Keys, class Values>
+void cosort(const indirect_policy& policy, Keys& keys, Values& values)
+{
+    cosort(policy, keys.begin(), keys.end(), values.begin(), values.end());
+}
+
+template <class Keys, class Values, class Comparator>
+void cosort(const indirect_policy& policy, Keys& keys, Values& values,
+            Comparator comp)
+{
+    cosort(policy, keys.begin(), keys.end(), values.begin(), values.end(), comp);
+}
+
+template <class Keys, class Values>
+void cosort(const parallel_policy& policy, Keys& keys, Values& values)
+{
+    cosort(policy, keys.begin(), keys.end(), values.begin(), values.end());
+}
+
+template <class Keys, class Values, class Comparator>
+void cosort(const parallel_policy& policy, Keys& keys, Values& values,
+            Comparator comp)
+{
+    cosort(policy, keys.begin(), keys.end(), values.begin(), values.end(), comp);
+}
+
+template <class key_iterator, class val_iterator>
+void stable_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, val_iterator /*vals_end*/)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    detail::stable_cosort(keys_begin, keys_end, vals_begin, std::less<key_type>());
+}
+
+template <class key_iterator, class val_iterator, class Comparator>
+void stable_cosort(key_iterator keys_begin, key_iterator keys_end,
+                   val_iterator vals_begin, val_iterator /*vals_end*/,
+                   Comparator comp)
+{
+    detail::stable_cosort(keys_begin, keys_end, vals_begin, comp);
+}
+
+template <class Keys, class Values>
+void stable_cosort(Keys& keys, Values& values)
+{
+    stable_cosort(keys.begin(), keys.end(), values.begin(), values.end());
+}
+
+template <class Keys, class Values, class Comparator>
+void stable_cosort(Keys& keys, Values& values, Comparator comp)
+{
+    stable_cosort(keys.begin(), keys.end(), values.begin(), values.end(), comp);
+}
+
+/*
+ * Sort only the smallest (keys_middle-keys_begin) keys into the front of
+ * the range, as std::partial_sort.
+ */
+template <class key_iterator, class val_iterator, class Comparator>
+void partial_cosort(key_iterator keys_begin, key_iterator keys_middle,
+                    key_iterator keys_end,
+                    val_iterator vals_begin, val_iterator /*vals_end*/,
+                    Comparator comp)
+{
+    detail::coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
+    std::partial_sort(begin, begin+(keys_middle-keys_begin),
+                      begin+(keys_end-keys_begin),
+                      detail::cocomparator<key_iterator,val_iterator,Comparator>(comp));
+}
+
+template <class key_iterator, class val_iterator>
+void partial_cosort(key_iterator keys_begin, key_iterator keys_middle,
+                    key_iterator keys_end,
+                    val_iterator vals_begin, val_iterator vals_end)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    partial_cosort(keys_begin, keys_middle, keys_end, vals_begin, vals_end,
+                   std::less<key_type>());
+}
+
+template <class Keys, class Values>
+void partial_cosort(Keys& keys, Values& values, size_t k)
+{
+    k = std::min<size_t>(k, keys.size());
+    partial_cosort(keys.begin(), std::next(keys.begin(), k), keys.end(),
+                   values.begin(), values.end());
+}
+
+template <class Keys, class Values, class Comparator>
+void partial_cosort(Keys& keys, Values& values, size_t k, Comparator comp)
+{
+    k = std::min<size_t>(k, keys.size());
+    partial_cosort(keys.begin(), std::next(keys.begin(), k), keys.end(),
+                   values.begin(), values.end(), comp);
+}
+
+/*
+ * Partition the range around the key which would be at keys_nth if it were
+ * sorted, as std::nth_element.
+ */
+template <class key_iterator, class val_iterator, class Comparator>
+void select_cosort(key_iterator keys_begin, key_iterator keys_nth,
+                   key_iterator keys_end,
+                   val_iterator vals_begin, val_iterator /*vals_end*/,
+                   Comparator comp)
+{
+    detail::coiterator<key_iterator,val_iterator> begin(keys_begin, vals_begin);
+    std::nth_element(begin, begin+(keys_nth-keys_begin),
+                     begin+(keys_end-keys_begin),
+                     detail::cocomparator<key_iterator,val_iterator,Comparator>(comp));
+}
+
+template <class key_iterator, class val_iterator>
+void select_cosort(key_iterator keys_begin, key_iterator keys_nth,
+                   key_iterator keys_end,
+                   val_iterator vals_begin, val_iterator vals_end)
+{
+    typedef typename std::iterator_traits<key_iterator>::value_type key_type;
+    select_cosort(keys_begin, keys_nth, keys_end, vals_begin, vals_end,
+                  std::less<key_type>());
+}
+
+template <class Keys, class Values>
+void select_cosort(Keys& keys, Values& values, size_t n)
+{
+    if (n >= keys.size()) return;
+    select_cosort(keys.begin(), std::next(keys.begin(), n), keys.end(),
+                  values.begin(), values.end());
+}
+
+template <class Keys, class Values, class Comparator>
+void select_cosort(Keys& keys, Values& values, size_t n, Comparator comp)
+{
+    if (n >= keys.size()) return;
+    select_cosort(keys.begin(), std::next(keys.begin(), n), keys.end(),
+                  values.begin(), values.end(), comp);
+}
+
 }
 
 #endif
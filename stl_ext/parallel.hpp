@@ -0,0 +1,175 @@
+#ifndef _STL_EXT_PARALLEL_HPP_
+#define _STL_EXT_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace stl_ext
+{
+
+/*
+ * Tag selecting the multi-threaded overload of an algorithm. A thread
+ * count of zero means "one thread per hardware thread"; par(n) requests
+ * exactly n threads.
+ */
+struct parallel_policy
+{
+    unsigned nthread;
+
+    constexpr parallel_policy(unsigned nthread_ = 0) : nthread(nthread_) {}
+
+    constexpr parallel_policy operator()(unsigned nthread_) const
+    {
+        return parallel_policy(nthread_);
+    }
+
+    unsigned num_threads() const
+    {
+        if (nthread > 0) return nthread;
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+};
+
+constexpr parallel_policy par;
+
+namespace detail
+{
+
+/*
+ * Start of chunk i when [0,n) is split into nchunk nearly equal pieces.
+ */
+inline size_t chunk_begin(size_t n, size_t nchunk, size_t i)
+{
+    return (n/nchunk)*i + std::min(i, n%nchunk);
+}
+
+/*
+ * Number of chunks to split n elements into so that every chunk holds at
+ * least min_chunk elements and no more threads than requested are used.
+ */
+inline size_t num_chunks(const parallel_policy& policy, size_t n,
+                         size_t min_chunk)
+{
+    size_t nchunk = std::min<size_t>(policy.num_threads(),
+                                     n/std::max<size_t>(min_chunk, 1));
+    return std::max<size_t>(nchunk, 1);
+}
+
+/*
+ * Call f(i, begin, end) for each of nchunk contiguous pieces of [0,n),
+ * each on its own thread. Chunk 0 runs on the calling thread. The first
+ * exception thrown by any chunk is rethrown once all threads have joined.
+ */
+template <typename Func>
+void parallel_chunks(size_t nchunk, size_t n, Func&& f)
+{
+    if (nchunk <= 1)
+    {
+        f(size_t(0), size_t(0), n);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(nchunk);
+    std::vector<std::thread> threads;
+    threads.reserve(nchunk-1);
+
+    auto run = [&](size_t i)
+    {
+        try
+        {
+            f(i, chunk_begin(n, nchunk, i), chunk_begin(n, nchunk, i+1));
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    for (size_t i = 1;i < nchunk;i++) threads.emplace_back(run, i);
+    run(0);
+    for (auto& t : threads) t.join();
+
+    for (auto& e : errors) if (e) std::rethrow_exception(e);
+}
+
+/*
+ * As above, but choose the number of chunks from the policy and a minimum
+ * chunk size. Returns the number of chunks used.
+ */
+template <typename Func>
+size_t parallel_for(const parallel_policy& policy, size_t n, size_t min_chunk,
+                    Func&& f)
+{
+    size_t nchunk = num_chunks(policy, n, min_chunk);
+    parallel_chunks(nchunk, n, std::forward<Func>(f));
+    return nchunk;
+}
+
+/*
+ * Parallel reductions work on chunks of this many elements regardless of
+ * the number of threads, so that the result does not depend on it.
+ */
+constexpr size_t parallel_reduce_chunk = 65536;
+
+/*
+ * Reduce [0,n), n > 0, as reduce(begin, end) of each fixed-size chunk in
+ * parallel, then fold the chunk results in order with combine(r, x).
+ */
+template <typename R, typename Reduce, typename Combine>
+R parallel_reduce(const parallel_policy& policy, size_t n, Reduce&& reduce,
+                  Combine&& combine)
+{
+    size_t nchunk = (n+parallel_reduce_chunk-1)/parallel_reduce_chunk;
+    std::vector<R> partial(nchunk);
+
+    parallel_for(policy, nchunk, 1,
+    [&](size_t, size_t first, size_t last)
+    {
+        for (size_t c = first;c < last;c++)
+            partial[c] = reduce(c*parallel_reduce_chunk,
+                                std::min(n, (c+1)*parallel_reduce_chunk));
+    });
+
+    R r = std::move(partial[0]);
+    for (size_t c = 1;c < nchunk;c++) combine(r, partial[c]);
+    return r;
+}
+
+/*
+ * Whether any(begin, end) holds for some block of [0,n). The threads check
+ * a shared flag between blocks, so all of them stop soon after a hit.
+ */
+template <typename Any>
+bool parallel_any(const parallel_policy& policy, size_t n, Any&& any)
+{
+    constexpr size_t block = 4096;
+    std::atomic<bool> found(false);
+
+    parallel_for(policy, n, block,
+    [&](size_t, size_t first, size_t last)
+    {
+        for (size_t b = first;b < last;b += block)
+        {
+            if (found.load(std::memory_order_relaxed)) return;
+            if (any(b, std::min(b+block, last)))
+            {
+                found.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+
+    return found.load();
+}
+
+}
+
+}
+
+#endif
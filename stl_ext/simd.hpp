@@ -0,0 +1,1340 @@
+#ifndef _STL_EXT_SIMD_HPP_
+#define _STL_EXT_SIMD_HPP_
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "type_traits.hpp"
+
+/*
+ * With GCC-compatible compilers on x86 the kernels below are written with
+ * generic vector types and compiled once per instruction set (SSE2, AVX2,
+ * AVX-512), the widest one supported by the running CPU being chosen at
+ * run time. Elsewhere the same kernels are used at a single 16-byte width,
+ * or, without vector extensions, as plain loops with several accumulators.
+ */
+#if defined(__GNUC__)
+#define STL_EXT_SIMD_VECTORS 1
+#if defined(__x86_64__) || defined(__i386__)
+#define STL_EXT_SIMD_DISPATCH 1
+#endif
+#endif
+
+#ifdef STL_EXT_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace stl_ext
+{
+
+namespace detail
+{
+
+/*
+ * Whether a container stores its elements contiguously, i.e. data() gives
+ * a pointer to them.
+ */
+template <typename T, typename=void>
+struct is_contiguous : std::false_type {};
+
+template <typename T>
+struct is_contiguous<T, enable_if_t<std::is_same<decltype(std::declval<const T&>().data()),
+                                                 const typename T::value_type*>::value>>
+: std::true_type {};
+
+/*
+ * Element types which fit in a vector register.
+ */
+template <typename U>
+struct is_vectorizable
+: std::integral_constant<bool, std::is_arithmetic<U>::value &&
+                               !std::is_same<U,bool>::value &&
+                               !std::is_same<U,long double>::value> {};
+
+/*
+ * Element types whose reductions may be reassociated, i.e. split across
+ * several accumulators.
+ */
+template <typename U>
+struct is_reorderable : std::is_arithmetic<U> {};
+
+template <typename U>
+struct is_reorderable<std::complex<U>> : std::is_arithmetic<U> {};
+
+/*
+ * Number of independent accumulators (vector registers) per reduction.
+ */
+constexpr size_t simd_accumulators = 4;
+
+/*
+ * Reduction operations. op(acc, x) folds x into acc for both scalars and
+ * vectors (in place, so that no function returns a vector by value);
+ * identity(p) is the starting value of every accumulator given the
+ * (non-empty) input p.
+ */
+struct plus_op
+{
+    template <typename U>
+    U identity(const U*) const { return U(); }
+
+    template <typename V>
+    void operator()(V& acc, const V& x) const { acc = acc+x; }
+};
+
+struct multiplies_op
+{
+    template <typename U>
+    U identity(const U*) const { return U(1); }
+
+    template <typename V>
+    void operator()(V& acc, const V& x) const { acc = acc*x; }
+};
+
+struct min_op
+{
+    template <typename U>
+    U identity(const U* p) const { return p[0]; }
+
+    template <typename U>
+    bool better(const U& x, const U& y) const { return x < y; }
+
+    template <typename V>
+    void operator()(V& acc, const V& x) const { acc = x < acc ? x : acc; }
+};
+
+struct max_op
+{
+    template <typename U>
+    U identity(const U* p) const { return p[0]; }
+
+    template <typename U>
+    bool better(const U& x, const U& y) const { return y < x; }
+
+    template <typename V>
+    void operator()(V& acc, const V& x) const { acc = acc < x ? x : acc; }
+};
+
+/*
+ * Fold p[0,n) with op into nout partial results, element i going to
+ * out[i%nout]. Works on simd_accumulators vectors of type V at a time;
+ * nout must divide the vector width.
+ */
+template <typename V, typename U, typename Op>
+inline void reduce_lanes(const U* p, size_t n, Op op, U* out, size_t nout)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+    constexpr size_t block = width*simd_accumulators;
+
+    U init = op.identity(p);
+    for (size_t l = 0;l < nout;l++) out[l] = init;
+
+    size_t i = 0;
+
+    if (n >= block)
+    {
+        V acc[simd_accumulators];
+        for (size_t j = 0;j < simd_accumulators;j++)
+            for (size_t l = 0;l < width;l++) acc[j][l] = init;
+
+        for (;i+block <= n;i += block)
+        {
+            for (size_t j = 0;j < simd_accumulators;j++)
+            {
+                V x;
+                memcpy(&x, p+i+j*width, sizeof(V));
+                op(acc[j], x);
+            }
+        }
+
+        for (;i+width <= n;i += width)
+        {
+            V x;
+            memcpy(&x, p+i, sizeof(V));
+            op(acc[0], x);
+        }
+
+        for (size_t j = 1;j < simd_accumulators;j++) op(acc[0], acc[j]);
+        for (size_t l = 0;l < width;l++) op(out[l%nout], U(acc[0][l]));
+    }
+
+    for (;i < n;i++) op(out[i%nout], p[i]);
+}
+
+/*
+ * The same with scalar accumulators, for types which do not vectorize.
+ */
+template <typename U, typename Op>
+U reduce_scalar(const U* p, size_t n, Op op)
+{
+    U acc[simd_accumulators];
+    for (size_t j = 0;j < simd_accumulators;j++) acc[j] = op.identity(p);
+
+    size_t i = 0;
+    for (;i+simd_accumulators <= n;i += simd_accumulators)
+        for (size_t j = 0;j < simd_accumulators;j++) op(acc[j], p[i+j]);
+
+    for (;i < n;i++) op(acc[0], p[i]);
+    for (size_t j = 1;j < simd_accumulators;j++) op(acc[0], acc[j]);
+
+    return acc[0];
+}
+
+#ifdef STL_EXT_SIMD_VECTORS
+
+template <typename U, size_t Bytes>
+struct simd_vector
+{
+    typedef U type __attribute__((vector_size(Bytes)));
+};
+
+#endif
+
+#ifdef STL_EXT_SIMD_DISPATCH
+
+/*
+ * Widest vector instruction set supported by this CPU: 2 for AVX-512 (with
+ * byte and word instructions), 1 for AVX2 and 0 for the SSE2 baseline.
+ */
+inline int simd_level()
+{
+    static const int level = __builtin_cpu_supports("avx512f") &&
+                             __builtin_cpu_supports("avx512bw") ? 2 :
+                             __builtin_cpu_supports("avx2") ? 1 : 0;
+    return level;
+}
+
+template <typename Kernel>
+__attribute__((target("avx512f,avx512bw"),flatten))
+void simd_run_avx512(Kernel& k)
+{
+    k.template apply<64>();
+}
+
+template <typename Kernel>
+__attribute__((target("avx2"),flatten))
+void simd_run_avx2(Kernel& k)
+{
+    k.template apply<32>();
+}
+
+#endif
+
+/*
+ * Run a kernel with the widest available vectors: k.apply<Bytes>() is
+ * given the vector size in bytes, and k.scalar() is used when the
+ * compiler has no vector extensions.
+ */
+template <typename Kernel>
+void simd_run(Kernel& k)
+{
+#if defined(STL_EXT_SIMD_DISPATCH)
+    switch (simd_level())
+    {
+        case 2: simd_run_avx512(k); return;
+        case 1: simd_run_avx2(k); return;
+    }
+#endif
+#if defined(STL_EXT_SIMD_VECTORS)
+    k.template apply<16>();
+#else
+    k.scalar();
+#endif
+}
+
+template <typename U, typename Op>
+struct reduce_kernel
+{
+    const U* p;
+    size_t n;
+    Op op;
+    U* out;
+    size_t nout;
+
+#ifdef STL_EXT_SIMD_VECTORS
+    template <size_t Bytes>
+    void apply()
+    {
+        reduce_lanes<typename simd_vector<U,Bytes>::type>(p, n, op, out, nout);
+    }
+#endif
+
+    void scalar()
+    {
+        for (size_t l = 0;l < nout;l++) out[l] = op.identity(p);
+        for (size_t i = 0;i < n;i++) op(out[i%nout], p[i]);
+    }
+};
+
+/*
+ * Fold p[0,n) into nout interleaved partial results using the widest
+ * available vectors.
+ */
+template <typename U, typename Op>
+void simd_reduce(const U* p, size_t n, Op op, U* out, size_t nout)
+{
+    reduce_kernel<U,Op> k{p, n, op, out, nout};
+    simd_run(k);
+}
+
+template <typename U, typename Op>
+U reduce(const U* p, size_t n, Op op, std::true_type)
+{
+    U r;
+    simd_reduce(p, n, op, &r, 1);
+    return r;
+}
+
+template <typename U, typename Op>
+U reduce(const U* p, size_t n, Op op, std::false_type)
+{
+    return reduce_scalar(p, n, op);
+}
+
+/*
+ * Reduce the non-empty range p[0,n) of arithmetic or complex elements.
+ * The order of operations is unspecified.
+ */
+template <typename U, typename Op>
+U reduce(const U* p, size_t n, Op op)
+{
+    return reduce(p, n, op, is_vectorizable<U>());
+}
+
+template <typename U>
+std::complex<U> reduce(const std::complex<U>* p, size_t n, plus_op op, std::true_type)
+{
+    U r[2];
+    simd_reduce(reinterpret_cast<const U*>(p), 2*n, op, r, 2);
+    return {r[0], r[1]};
+}
+
+template <typename U>
+std::complex<U> reduce(const std::complex<U>* p, size_t n, plus_op op, std::false_type)
+{
+    return reduce_scalar(p, n, op);
+}
+
+/*
+ * Complex sums are taken over the interleaved real and imaginary parts.
+ */
+template <typename U>
+std::complex<U> reduce(const std::complex<U>* p, size_t n, plus_op op)
+{
+    return reduce(p, n, op, is_vectorizable<U>());
+}
+
+/*
+ * Neumaier's variant of Kahan summation: add x to s, collecting the
+ * rounding error in c. Works elementwise on vectors. This relies on strict
+ * IEEE semantics, and -ffast-math or similar will optimize the compensation
+ * away.
+ */
+template <typename V>
+inline void neumaier_add(V& s, V& c, const V& x)
+{
+    V zero{};
+    V t = s+x;
+    V abs_s = s < zero ? -s : s;
+    V abs_x = x < zero ? -x : x;
+    c += abs_s < abs_x ? (x-t)+s : (s-t)+x;
+    s = t;
+}
+
+/*
+ * Compensated sum of p[0,n) into nout (1 or 2) interleaved results, with
+ * simd_accumulators independent vector sums and compensations.
+ */
+template <typename V, typename U>
+inline void compensated_lanes(const U* p, size_t n, U* out, size_t nout)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+    constexpr size_t block = width*simd_accumulators;
+
+    U s[2] = {}, c[2] = {};
+    size_t i = 0;
+
+    if (n >= block)
+    {
+        V vs[simd_accumulators] = {}, vc[simd_accumulators] = {};
+
+        for (;i+block <= n;i += block)
+        {
+            for (size_t j = 0;j < simd_accumulators;j++)
+            {
+                V x;
+                memcpy(&x, p+i+j*width, sizeof(V));
+                neumaier_add(vs[j], vc[j], x);
+            }
+        }
+
+        for (size_t j = 0;j < simd_accumulators;j++)
+        {
+            for (size_t l = 0;l < width;l++)
+            {
+                neumaier_add(s[l%nout], c[l%nout], U(vs[j][l]));
+                c[l%nout] += vc[j][l];
+            }
+        }
+    }
+
+    for (;i < n;i++) neumaier_add(s[i%nout], c[i%nout], p[i]);
+    for (size_t l = 0;l < nout;l++) out[l] = s[l]+c[l];
+}
+
+/*
+ * Pairwise summation: blocks of this many elements are summed directly
+ * with vectors, and the block sums combined as the leaves of a balanced
+ * binary tree. The tree is built bottom-up with a stack of partial sums, as
+ * when counting in binary, so that the whole sum runs as a single kernel.
+ */
+constexpr size_t pairwise_sum_block = 2048;
+
+template <typename V, typename U>
+inline void pairwise_lanes(const U* p, size_t n, U* out, size_t nout)
+{
+    U stack[64][2];
+    unsigned level[64];
+    size_t depth = 0;
+    size_t block = pairwise_sum_block*nout;
+
+    for (size_t i = 0;i < n;i += block)
+    {
+        U part[2];
+        reduce_lanes<V>(p+i, std::min(block, n-i), plus_op(), part, nout);
+
+        unsigned lv = 0;
+        for (;depth > 0 && level[depth-1] == lv;depth--,lv++)
+            for (size_t l = 0;l < nout;l++) part[l] = stack[depth-1][l]+part[l];
+
+        for (size_t l = 0;l < nout;l++) stack[depth][l] = part[l];
+        level[depth++] = lv;
+    }
+
+    for (size_t l = 0;l < nout;l++) out[l] = U();
+    while (depth > 0)
+    {
+        depth--;
+        for (size_t l = 0;l < nout;l++) out[l] = stack[depth][l]+out[l];
+    }
+}
+
+/*
+ * Blocked summation: each vector accumulator sums blocks of this many
+ * vectors directly, and the block sums are added to compensated totals
+ * per lane, so that no lane collects more than a few rounding errors
+ * before they are captured.
+ */
+constexpr size_t blocked_sum_block = 16;
+
+template <typename V, typename U>
+inline void blocked_lanes(const U* p, size_t n, U* out, size_t nout)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+    constexpr size_t block = width*simd_accumulators*blocked_sum_block;
+
+    U s[2] = {}, c[2] = {};
+    size_t i = 0;
+
+    if (n >= block)
+    {
+        V vs[simd_accumulators] = {}, vc[simd_accumulators] = {};
+
+        for (;i+block <= n;i += block)
+        {
+            V acc[simd_accumulators] = {};
+
+            for (size_t k = 0;k < blocked_sum_block;k++)
+            {
+                for (size_t j = 0;j < simd_accumulators;j++)
+                {
+                    V x;
+                    memcpy(&x, p+i+(k*simd_accumulators+j)*width, sizeof(V));
+                    acc[j] += x;
+                }
+            }
+
+            for (size_t j = 0;j < simd_accumulators;j++)
+                neumaier_add(vs[j], vc[j], acc[j]);
+        }
+
+        for (size_t j = 0;j < simd_accumulators;j++)
+        {
+            for (size_t l = 0;l < width;l++)
+            {
+                neumaier_add(s[l%nout], c[l%nout], U(vs[j][l]));
+                c[l%nout] += vc[j][l];
+            }
+        }
+    }
+
+    if (i < n)
+    {
+        U part[2];
+        reduce_lanes<V>(p+i, n-i, plus_op(), part, nout);
+        for (size_t l = 0;l < nout;l++) neumaier_add(s[l], c[l], part[l]);
+    }
+
+    for (size_t l = 0;l < nout;l++) out[l] = s[l]+c[l];
+}
+
+template <typename Policy, typename U>
+struct summation_kernel
+{
+    const U* p;
+    size_t n;
+    U* out;
+    size_t nout;
+
+#ifdef STL_EXT_SIMD_VECTORS
+    template <size_t Bytes>
+    void apply()
+    {
+        Policy::template sum<typename simd_vector<U,Bytes>::type>(p, n, out, nout);
+    }
+#endif
+
+    void scalar()
+    {
+        Policy::template sum<U>(p, n, out, nout);
+    }
+};
+
+/*
+ * Vector kernels of the summation policies in algorithm.hpp.
+ */
+struct compensated_summation
+{
+    template <typename V, typename U>
+    static void sum(const U* p, size_t n, U* out, size_t nout)
+    {
+        compensated_lanes<V>(p, n, out, nout);
+    }
+};
+
+struct pairwise_summation
+{
+    template <typename V, typename U>
+    static void sum(const U* p, size_t n, U* out, size_t nout)
+    {
+        pairwise_lanes<V>(p, n, out, nout);
+    }
+};
+
+struct blocked_summation
+{
+    template <typename V, typename U>
+    static void sum(const U* p, size_t n, U* out, size_t nout)
+    {
+        blocked_lanes<V>(p, n, out, nout);
+    }
+};
+
+/*
+ * Sum p[0,n) into nout (1 or 2) interleaved results as Summation does.
+ */
+template <typename Summation, typename U>
+void simd_sum(const U* p, size_t n, U* out, size_t nout)
+{
+    summation_kernel<Summation,U> k{p, n, out, nout};
+    simd_run(k);
+}
+
+#ifdef STL_EXT_SIMD_VECTORS
+
+template <size_t N> struct sized_int;
+template <> struct sized_int<1> { typedef int8_t type; };
+template <> struct sized_int<2> { typedef int16_t type; };
+template <> struct sized_int<4> { typedef int32_t type; };
+template <> struct sized_int<8> { typedef int64_t type; };
+
+/*
+ * r[i] = x[I[i]] where indices of sizeof...(I) and up pick zero.
+ */
+template <typename U, typename V, size_t... I>
+inline void permute_lanes(V& r, const V& x, std::integral_constant<size_t,I>...)
+{
+    V zero{};
+#if defined(__clang__)
+    r = __builtin_shufflevector(x, zero, I...);
+#else
+    typedef typename sized_int<sizeof(U)>::type M __attribute__((vector_size(sizeof(V))));
+    r = __builtin_shuffle(x, zero, M{I...});
+#endif
+}
+
+/*
+ * r = x shifted up by S lanes, with zeros shifted in.
+ */
+template <size_t S, typename U, typename V, size_t... I>
+inline void shift_lanes_up(V& r, const V& x, std::index_sequence<I...>)
+{
+    permute_lanes<U>(r, x, std::integral_constant<size_t,(I < S ? sizeof...(I) : I-S)>()...);
+}
+
+/*
+ * r = the last lane of x in every lane.
+ */
+template <typename U, typename V, size_t... I>
+inline void broadcast_last_lane(V& r, const V& x, std::index_sequence<I...>)
+{
+    permute_lanes<U>(r, x, std::integral_constant<size_t,(I+sizeof...(I)-1-I)>()...);
+}
+
+/*
+ * Inclusive scan of the W lanes of a vector in log2(W) shift-and-add steps.
+ */
+template <size_t S, size_t W>
+struct lane_scan
+{
+    template <typename U, typename V>
+    static void apply(V& x)
+    {
+        V t;
+        shift_lanes_up<S,U>(t, x, std::make_index_sequence<W>());
+        x += t;
+        lane_scan<2*S,W>::template apply<U>(x);
+    }
+};
+
+template <size_t W>
+struct lane_scan<W,W>
+{
+    template <typename U, typename V>
+    static void apply(V&) {}
+};
+
+/*
+ * out[i] = carry+in[0]+...+in[i], one vector at a time, with the running
+ * total kept in every lane of a vector. Returns the total. in and out may
+ * be the same. For integers this gives the same result as a serial loop.
+ */
+template <typename V, typename U>
+inline U scan_lanes(const U* in, U* out, size_t n, U carry)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+
+    V c{};
+    c += carry;
+
+    size_t i = 0;
+    for (;i+width <= n;i += width)
+    {
+        V x;
+        memcpy(&x, in+i, sizeof(V));
+        lane_scan<1,width>::template apply<U>(x);
+        x += c;
+        memcpy(out+i, &x, sizeof(V));
+        broadcast_last_lane<U>(c, x, std::make_index_sequence<width>());
+    }
+
+    carry = c[0];
+    for (;i < n;i++) out[i] = carry = carry+in[i];
+    return carry;
+}
+
+/*
+ * As scan_lanes, but out[i] = carry+in[0]+...+in[i-1].
+ */
+template <typename V, typename U>
+inline U exclusive_scan_lanes(const U* in, U* out, size_t n, U carry)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+
+    V c{};
+    c += carry;
+
+    size_t i = 0;
+    for (;i+width <= n;i += width)
+    {
+        V x, e, t;
+        memcpy(&x, in+i, sizeof(V));
+        lane_scan<1,width>::template apply<U>(x);
+        shift_lanes_up<1,U>(e, x, std::make_index_sequence<width>());
+        e += c;
+        memcpy(out+i, &e, sizeof(V));
+        broadcast_last_lane<U>(t, x, std::make_index_sequence<width>());
+        c += t;
+    }
+
+    carry = c[0];
+    for (;i < n;i++)
+    {
+        U x = in[i];
+        out[i] = carry;
+        carry = carry+x;
+    }
+    return carry;
+}
+
+/*
+ * Segmented inclusive scan of the lanes of x, where f is -1 in the lanes
+ * which start a segment and 0 elsewhere. On return f is -1 in the lanes
+ * with a segment start at or below them.
+ */
+template <size_t S, size_t W>
+struct segmented_lane_scan
+{
+    template <typename U, typename I, typename V, typename M>
+    static void apply(V& x, M& f)
+    {
+        V xs;
+        M fs;
+        shift_lanes_up<S,U>(xs, x, std::make_index_sequence<W>());
+        shift_lanes_up<S,I>(fs, f, std::make_index_sequence<W>());
+        x = f != 0 ? x : x+xs;
+        f |= fs;
+        segmented_lane_scan<2*S,W>::template apply<U,I>(x, f);
+    }
+};
+
+template <size_t W>
+struct segmented_lane_scan<W,W>
+{
+    template <typename U, typename I, typename V, typename M>
+    static void apply(V&, M&) {}
+};
+
+/*
+ * out[i] = in[j]+...+in[i] where j <= i is the last index with head(j)
+ * true; head(0) must be true. in and out may be the same.
+ */
+template <typename V, typename U, typename Head>
+inline void segmented_scan_lanes(const U* in, U* out, size_t n, Head& head)
+{
+    constexpr size_t width = sizeof(V)/sizeof(U);
+    typedef typename sized_int<sizeof(U)>::type I;
+    typedef I M __attribute__((vector_size(sizeof(V))));
+
+    V c{};
+
+    size_t i = 0;
+    for (;i+width <= n;i += width)
+    {
+        V x;
+        M f;
+        memcpy(&x, in+i, sizeof(V));
+        for (size_t l = 0;l < width;l++) f[l] = head(i+l) ? -1 : 0;
+        segmented_lane_scan<1,width>::template apply<U,I>(x, f);
+        x = f != 0 ? x : x+c;
+        memcpy(out+i, &x, sizeof(V));
+        broadcast_last_lane<U>(c, x, std::make_index_sequence<width>());
+    }
+
+    U carry = c[0];
+    for (;i < n;i++) out[i] = carry = head(i) ? in[i] : carry+in[i];
+}
+
+#endif
+
+template <typename U>
+struct exclusive_scan_kernel
+{
+    const U* in;
+    U* out;
+    size_t n;
+    U carry;
+
+#ifdef STL_EXT_SIMD_VECTORS
+    template <size_t Bytes>
+    void apply()
+    {
+        carry = exclusive_scan_lanes<typename simd_vector<U,Bytes>::type>(in, out, n, carry);
+    }
+#endif
+
+    void scalar()
+    {
+        for (size_t i = 0;i < n;i++)
+        {
+            U x = in[i];
+            out[i] = carry;
+            carry = carry+x;
+        }
+    }
+};
+
+/*
+ * out[i] = carry+in[0]+...+in[i-1] for vectorizable U. Returns the total.
+ */
+template <typename U>
+U simd_exclusive_scan(const U* in, U* out, size_t n, U carry)
+{
+    exclusive_scan_kernel<U> k{in, out, n, carry};
+    simd_run(k);
+    return k.carry;
+}
+
+template <typename U, typename Head>
+struct segmented_scan_kernel
+{
+    const U* in;
+    U* out;
+    size_t n;
+    Head& head;
+
+#ifdef STL_EXT_SIMD_VECTORS
+    template <size_t Bytes>
+    void apply()
+    {
+        segmented_scan_lanes<typename simd_vector<U,Bytes>::type>(in, out, n, head);
+    }
+#endif
+
+    void scalar()
+    {
+        U carry = U();
+        for (size_t i = 0;i < n;i++) out[i] = carry = head(i) ? in[i] : carry+in[i];
+    }
+};
+
+/*
+ * Segmented inclusive scan for vectorizable U, segments starting at the
+ * indices i where head(i) is true. head(0) must be true.
+ */
+template <typename U, typename Head>
+void simd_segmented_scan(const U* in, U* out, size_t n, Head& head)
+{
+    segmented_scan_kernel<U,Head> k{in, out, n, head};
+    simd_run(k);
+}
+
+template <typename U>
+struct scan_kernel
+{
+    const U* in;
+    U* out;
+    size_t n;
+    U carry;
+
+#ifdef STL_EXT_SIMD_VECTORS
+    template <size_t Bytes>
+    void apply()
+    {
+        carry = scan_lanes<typename simd_vector<U,Bytes>::type>(in, out, n, carry);
+    }
+#endif
+
+    void scalar()
+    {
+        for (size_t i = 0;i < n;i++) out[i] = carry = carry+in[i];
+    }
+};
+
+/*
+ * out[i] = carry+in[0]+...+in[i] for vectorizable U. Returns the total.
+ */
+template <typename U>
+U simd_scan(const U* in, U* out, size_t n, U carry)
+{
+    scan_kernel<U> k{in, out, n, carry};
+    simd_run(k);
+    return k.carry;
+}
+
+/*
+ * Position of the first element of the non-empty range p[0,n) which is
+ * not bettered by any other according to op (min_op or max_op). Unordered
+ * elements (NaN) are skipped unless p[0] is one, as with a sequential scan.
+ * Whole blocks are reduced with vectors, each from its first ordered
+ * element, and only the block holding the result is searched.
+ */
+template <typename U, typename Op>
+size_t reduce_pos(const U* p, size_t n, Op op)
+{
+    constexpr size_t block = 2048;
+
+    U best = p[0];
+    if (!(best == best)) return 0;
+
+    size_t best_block = 0;
+    for (size_t b = 0;b < n;b += block)
+    {
+        size_t end = std::min(b+block, n);
+        size_t from = b;
+        while (from < end && !(p[from] == p[from])) from++;
+        if (from == end) continue;
+
+        U m = reduce(p+from, end-from, op);
+        if (op.better(m, best))
+        {
+            best = m;
+            best_block = b;
+        }
+    }
+
+    size_t end = std::min(best_block+block, n);
+    for (size_t i = best_block;i < end;i++)
+    {
+        if (!op.better(p[i], best) && !op.better(best, p[i]) && p[i] == p[i])
+            return i;
+    }
+
+    return best_block;
+}
+
+/*
+ * Stream compaction. compress(out, in, n, bits) copies the elements in[i],
+ * i < n <= 64, whose bit i of bits is set to the front of out, in order,
+ * and returns how many there are. out may be in itself or any position
+ * before it. Only out[0,n) is written, but all of it may be: beyond the
+ * returned count its contents are unspecified.
+ *
+ * The portable version stores every element and advances the output only
+ * past those which are selected, so there is no data-dependent branch.
+ */
+template <typename U>
+size_t compress_scalar(U* out, const U* in, size_t n, uint64_t bits)
+{
+    size_t k = 0;
+    for (size_t i = 0;i < n;i++)
+    {
+        out[k] = in[i];
+        k += (bits >> i) & 1;
+    }
+    return k;
+}
+
+template <typename U, size_t Size>
+size_t compress(U* out, const U* in, size_t n, uint64_t bits,
+                std::integral_constant<size_t,Size>)
+{
+    return compress_scalar(out, in, n, bits);
+}
+
+#ifdef STL_EXT_SIMD_DISPATCH
+
+/*
+ * For each 8-bit mask, the positions of its set bits packed into the low
+ * bytes, i.e. the lane permutation which compresses 8 lanes.
+ */
+inline const uint64_t* compress_permutations()
+{
+    struct table
+    {
+        uint64_t idx[256];
+
+        table()
+        {
+            for (unsigned m = 0;m < 256;m++)
+            {
+                idx[m] = 0;
+                unsigned k = 0;
+                for (unsigned j = 0;j < 8;j++)
+                    if (m & (1u << j)) idx[m] |= uint64_t(j) << (8*k++);
+            }
+        }
+    };
+
+    static const table t;
+    return t.idx;
+}
+
+__attribute__((target("avx512f,popcnt")))
+inline size_t compress_avx512(void* out, const void* in, size_t n, uint64_t bits,
+                              std::integral_constant<size_t,4>)
+{
+    auto o = static_cast<uint32_t*>(out);
+    auto p = static_cast<const uint32_t*>(in);
+
+    size_t k = 0, i = 0;
+    for (;i+16 <= n;i += 16)
+    {
+        __mmask16 m = __mmask16(bits >> i);
+        __m512i x = _mm512_loadu_si512(p+i);
+        _mm512_storeu_si512(o+k, _mm512_maskz_compress_epi32(m, x));
+        k += __builtin_popcount(m);
+    }
+
+    if (i < n)
+    {
+        __mmask16 live = __mmask16((1u << (n-i))-1);
+        __mmask16 m = __mmask16(bits >> i) & live;
+        __m512i x = _mm512_maskz_loadu_epi32(live, p+i);
+        _mm512_mask_compressstoreu_epi32(o+k, m, x);
+        k += __builtin_popcount(m);
+    }
+
+    return k;
+}
+
+__attribute__((target("avx512f,popcnt")))
+inline size_t compress_avx512(void* out, const void* in, size_t n, uint64_t bits,
+                              std::integral_constant<size_t,8>)
+{
+    auto o = static_cast<uint64_t*>(out);
+    auto p = static_cast<const uint64_t*>(in);
+
+    size_t k = 0, i = 0;
+    for (;i+8 <= n;i += 8)
+    {
+        __mmask8 m = __mmask8(bits >> i);
+        __m512i x = _mm512_loadu_si512(p+i);
+        _mm512_storeu_si512(o+k, _mm512_maskz_compress_epi64(m, x));
+        k += __builtin_popcount(m);
+    }
+
+    if (i < n)
+    {
+        __mmask8 live = __mmask8((1u << (n-i))-1);
+        __mmask8 m = __mmask8(bits >> i) & live;
+        __m512i x = _mm512_maskz_loadu_epi64(live, p+i);
+        _mm512_mask_compressstoreu_epi64(o+k, m, x);
+        k += __builtin_popcount(m);
+    }
+
+    return k;
+}
+
+/*
+ * AVX2 has no compress instruction: permute 8 dwords with an index vector
+ * looked up from the mask, and store the whole vector.
+ */
+__attribute__((target("avx2,popcnt")))
+inline size_t compress_avx2(void* out, const void* in, size_t n, uint64_t bits,
+                            std::integral_constant<size_t,4>)
+{
+    auto o = static_cast<uint32_t*>(out);
+    auto p = static_cast<const uint32_t*>(in);
+    const uint64_t* perm = compress_permutations();
+
+    size_t k = 0, i = 0;
+    for (;i+8 <= n;i += 8)
+    {
+        unsigned m = unsigned(bits >> i) & 0xff;
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(perm[m]));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(o+k),
+                            _mm256_permutevar8x32_epi32(x, idx));
+        k += __builtin_popcount(m);
+    }
+
+    if (i == n) return k;
+    return k+compress_scalar(o+k, p+i, n-i, bits >> i);
+}
+
+/*
+ * As above with each qword moved as a pair of dwords: bit j of the 4-bit
+ * mask becomes bits 2j and 2j+1 of the permutation index.
+ */
+__attribute__((target("avx2,popcnt")))
+inline size_t compress_avx2(void* out, const void* in, size_t n, uint64_t bits,
+                            std::integral_constant<size_t,8>)
+{
+    static const uint8_t pairs[16] =
+    {
+        0x00, 0x03, 0x0c, 0x0f, 0x30, 0x33, 0x3c, 0x3f,
+        0xc0, 0xc3, 0xcc, 0xcf, 0xf0, 0xf3, 0xfc, 0xff
+    };
+
+    auto o = static_cast<uint64_t*>(out);
+    auto p = static_cast<const uint64_t*>(in);
+    const uint64_t* perm = compress_permutations();
+
+    size_t k = 0, i = 0;
+    for (;i+4 <= n;i += 4)
+    {
+        unsigned m = unsigned(bits >> i) & 0xf;
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(perm[pairs[m]]));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(o+k),
+                            _mm256_permutevar8x32_epi32(x, idx));
+        k += __builtin_popcount(m);
+    }
+
+    if (i == n) return k;
+    return k+compress_scalar(o+k, p+i, n-i, bits >> i);
+}
+
+/*
+ * Bytes are compressed 8 at a time by extracting the selected bytes of a
+ * 64-bit word with pext.
+ */
+__attribute__((target("bmi,bmi2,popcnt")))
+inline size_t compress_bmi2(void* out, const void* in, size_t n, uint64_t bits)
+{
+    auto o = static_cast<uint8_t*>(out);
+    auto p = static_cast<const uint8_t*>(in);
+
+    size_t k = 0, i = 0;
+    for (;i+8 <= n;i += 8)
+    {
+        unsigned m = unsigned(bits >> i) & 0xff;
+        uint64_t x;
+        std::memcpy(&x, p+i, 8);
+        x = _pext_u64(x, _pdep_u64(m, 0x0101010101010101ull)*0xff);
+        std::memcpy(o+k, &x, 8);
+        k += __builtin_popcount(m);
+    }
+
+    if (i == n) return k;
+    return k+compress_scalar(o+k, p+i, n-i, bits >> i);
+}
+
+template <typename U, typename Size>
+size_t compress_dispatch(U* out, const U* in, size_t n, uint64_t bits, Size size)
+{
+    switch (simd_level())
+    {
+        case 2: return compress_avx512(out, in, n, bits, size);
+        case 1: return compress_avx2(out, in, n, bits, size);
+    }
+    return compress_scalar(out, in, n, bits);
+}
+
+template <typename U>
+size_t compress(U* out, const U* in, size_t n, uint64_t bits,
+                std::integral_constant<size_t,1>)
+{
+    static const bool bmi2 = __builtin_cpu_supports("bmi2");
+    if (bmi2) return compress_bmi2(out, in, n, bits);
+    return compress_scalar(out, in, n, bits);
+}
+
+template <typename U>
+size_t compress(U* out, const U* in, size_t n, uint64_t bits,
+                std::integral_constant<size_t,4> size)
+{
+    return compress_dispatch(out, in, n, bits, size);
+}
+
+template <typename U>
+size_t compress(U* out, const U* in, size_t n, uint64_t bits,
+                std::integral_constant<size_t,8> size)
+{
+    return compress_dispatch(out, in, n, bits, size);
+}
+
+#endif
+
+/*
+ * Compress trivially copyable elements, with vector instructions when they
+ * are 4 or 8 bytes long and with pext when they are single bytes.
+ */
+template <typename U>
+size_t compress(U* out, const U* in, size_t n, uint64_t bits)
+{
+    return compress(out, in, n, bits, std::integral_constant<size_t,sizeof(U)>());
+}
+
+/*
+ * A set of bytes, kept both as a 256-bit mask and as the nibble tables used
+ * by the vector kernels of classify(): bit h&7 of rows[16*(h/8)+l] is set
+ * when the byte 16*h+l is in the set.
+ */
+class byte_set
+{
+    private:
+        uint64_t words_[4] = {};
+        uint8_t rows_[32] = {};
+
+    public:
+        byte_set() {}
+
+        void insert(unsigned char c)
+        {
+            words_[c >> 6] |= uint64_t(1) << (c & 63);
+            rows_[(c >> 7)*16 + (c & 15)] |= uint8_t(1u << ((c >> 4) & 7));
+        }
+
+        bool contains(unsigned char c) const
+        {
+            return (words_[c >> 6] >> (c & 63)) & 1;
+        }
+
+        const uint8_t* rows() const { return rows_; }
+};
+
+/*
+ * Byte classification. classify(set, p, n) returns the mask of the bytes
+ * p[i], i < n <= 64, which are in set.
+ */
+inline uint64_t classify_scalar(const byte_set& set, const unsigned char* p, size_t n)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0;i < n;i++) bits |= uint64_t(set.contains(p[i])) << i;
+    return bits;
+}
+
+#ifdef STL_EXT_SIMD_DISPATCH
+
+/*
+ * Each byte looks up its row (the members sharing its low nibble) with
+ * pshufb, from the first table if its top bit is clear and from the second
+ * otherwise (pshufb gives zero for indices with the top bit set), and
+ * tests the bit of the row selected by its high nibble.
+ */
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t classify_avx512(const byte_set& set, const unsigned char* p, size_t n)
+{
+    /* maskz: the plain broadcast trips -Wuninitialized in GCC */
+    const __mmask16 all = ~__mmask16(0);
+    const __m512i lo = _mm512_maskz_broadcast_i32x4(all,
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.rows())));
+    const __m512i hi = _mm512_maskz_broadcast_i32x4(all,
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.rows()+16)));
+    const __m512i bit = _mm512_maskz_broadcast_i32x4(all,
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128));
+
+    __mmask64 live = n < 64 ? (__mmask64(1) << n)-1 : ~__mmask64(0);
+    __m512i x = _mm512_maskz_loadu_epi8(live, p);
+    __m512i row = _mm512_or_si512(_mm512_shuffle_epi8(lo, x),
+        _mm512_shuffle_epi8(hi, _mm512_xor_si512(x, _mm512_set1_epi8(-128))));
+    __m512i sel = _mm512_shuffle_epi8(bit,
+        _mm512_and_si512(_mm512_srli_epi16(x, 4), _mm512_set1_epi8(0x0f)));
+
+    return _mm512_test_epi8_mask(row, sel) & live;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t classify_avx2(const byte_set& set, const unsigned char* p, size_t n)
+{
+    const __m256i lo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.rows())));
+    const __m256i hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.rows()+16)));
+    const __m256i bit = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128));
+
+    uint64_t bits = 0;
+    size_t i = 0;
+    for (;i+32 <= n;i += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p+i));
+        __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lo, x),
+            _mm256_shuffle_epi8(hi, _mm256_xor_si256(x, _mm256_set1_epi8(-128))));
+        __m256i sel = _mm256_shuffle_epi8(bit,
+            _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0f)));
+        __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(row, sel), sel);
+        bits |= uint64_t(uint32_t(_mm256_movemask_epi8(hit))) << i;
+    }
+
+    if (i < n) bits |= classify_scalar(set, p+i, n-i) << i;
+    return bits;
+}
+
+#endif
+
+inline uint64_t classify(const byte_set& set, const unsigned char* p, size_t n)
+{
+#ifdef STL_EXT_SIMD_DISPATCH
+    switch (simd_level())
+    {
+        case 2: return classify_avx512(set, p, n);
+        case 1: return classify_avx2(set, p, n);
+    }
+#endif
+    return classify_scalar(set, p, n);
+}
+
+/*
+ * Substring search. find_bytes(h, n, s, m) returns the position of the
+ * first occurrence of s[0,m) in h[0,n), or n if there is none.
+ *
+ * Candidates are positions where both the first and the last byte of s
+ * match, which are then compared in full. Without vector instructions the
+ * first byte is found with memchr.
+ */
+inline size_t find_bytes_scalar(const unsigned char* h, size_t n,
+                                const unsigned char* s, size_t m)
+{
+    if (n < m) return n;
+
+    const unsigned char* end = h+n-m+1;
+    for (auto p = h;p < end;p++)
+    {
+        p = static_cast<const unsigned char*>(std::memchr(p, s[0], end-p));
+        if (!p) break;
+        if (p[m-1] == s[m-1] && std::memcmp(p+1, s+1, m-1) == 0) return p-h;
+    }
+
+    return n;
+}
+
+#ifdef STL_EXT_SIMD_DISPATCH
+
+/*
+ * These require 2 <= m <= n.
+ */
+__attribute__((target("avx512f,avx512bw,bmi")))
+inline size_t find_bytes_avx512(const unsigned char* h, size_t n,
+                                const unsigned char* s, size_t m)
+{
+    const __m512i first = _mm512_set1_epi8(char(s[0]));
+    const __m512i last = _mm512_set1_epi8(char(s[m-1]));
+
+    size_t i = 0;
+    for (;i+m-1+64 <= n;i += 64)
+    {
+        __m512i a = _mm512_loadu_si512(h+i);
+        __m512i b = _mm512_loadu_si512(h+i+m-1);
+        uint64_t hits = _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(a, first), b, last);
+
+        for (;hits;hits &= hits-1)
+        {
+            size_t j = i+__builtin_ctzll(hits);
+            if (std::memcmp(h+j+1, s+1, m-2) == 0) return j;
+        }
+    }
+
+    return i+find_bytes_scalar(h+i, n-i, s, m);
+}
+
+__attribute__((target("avx2,bmi")))
+inline size_t find_bytes_avx2(const unsigned char* h, size_t n,
+                              const unsigned char* s, size_t m)
+{
+    const __m256i first = _mm256_set1_epi8(char(s[0]));
+    const __m256i last = _mm256_set1_epi8(char(s[m-1]));
+
+    size_t i = 0;
+    for (;i+m-1+32 <= n;i += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h+i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h+i+m-1));
+        uint32_t hits = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                              _mm256_cmpeq_epi8(b, last)));
+
+        for (;hits;hits &= hits-1)
+        {
+            size_t j = i+__builtin_ctz(hits);
+            if (std::memcmp(h+j+1, s+1, m-2) == 0) return j;
+        }
+    }
+
+    return i+find_bytes_scalar(h+i, n-i, s, m);
+}
+
+#endif
+
+inline size_t find_bytes(const unsigned char* h, size_t n,
+                         const unsigned char* s, size_t m)
+{
+    if (m == 0) return 0;
+    if (n < m) return n;
+
+    if (m == 1)
+    {
+        auto p = static_cast<const unsigned char*>(std::memchr(h, s[0], n));
+        return p ? p-h : n;
+    }
+
+#ifdef STL_EXT_SIMD_DISPATCH
+    switch (simd_level())
+    {
+        case 2: return find_bytes_avx512(h, n, s, m);
+        case 1: return find_bytes_avx2(h, n, s, m);
+    }
+#endif
+    return find_bytes_scalar(h, n, s, m);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef _STL_EXT_VIEW_HPP_
+#define _STL_EXT_VIEW_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "type_traits.hpp"
+
+/*
+ * Lazy counterparts of map, filtered, erased and zip. A view refers to its
+ * input range (or holds it, if it was given an rvalue, e.g. another view)
+ * and computes its elements only while being iterated, so a chain of views
+ * runs as a single loop over the original data:
+ *
+ *     auto v = view::collect(view::map(f, view::filter(x, pred)));
+ *
+ * makes one pass over x and one allocation for the result. Views are
+ * iterated through non-const begin() and end().
+ */
+
+namespace stl_ext
+{
+
+namespace detail
+{
+
+template <typename Range>
+using range_iterator_t = decltype(std::declval<Range&>().begin());
+
+template <typename Iterator>
+using range_reference_t = decltype(*std::declval<Iterator&>());
+
+/*
+ * Views of input iterators are input iterators, views of anything better
+ * are forward iterators.
+ */
+template <typename Iterator>
+using view_iterator_category =
+    conditional_t<std::is_base_of<std::forward_iterator_tag,
+                                  typename std::iterator_traits<Iterator>::iterator_category>::value,
+                  std::forward_iterator_tag, std::input_iterator_tag>;
+
+/*
+ * The number of elements of r if it is known without iterating, used to
+ * reserve space when collecting: r.size_hint() for views, r.size() for
+ * containers, and 0 (no reservation) otherwise, e.g. for filtered views.
+ */
+template <typename Range>
+auto size_hint(Range& r, int) -> decltype(size_t(r.size_hint()))
+{
+    return r.size_hint();
+}
+
+template <typename Range>
+auto size_hint(Range& r, long) -> decltype(size_t(r.size()))
+{
+    return r.size();
+}
+
+template <typename Range>
+size_t size_hint(Range&, ...)
+{
+    return 0;
+}
+
+template <typename Range>
+size_t range_size_hint(Range& r)
+{
+    return size_hint(r, 0);
+}
+
+template <typename Container>
+auto reserve(Container& c, size_t n, int) -> decltype(c.reserve(n))
+{
+    c.reserve(n);
+}
+
+template <typename Container>
+void reserve(Container&, size_t, long) {}
+
+template <typename Predicate>
+struct not_fn
+{
+    Predicate pred;
+
+    template <typename T>
+    bool operator()(T&& x)
+    {
+        return !pred(std::forward<T>(x));
+    }
+};
+
+template <typename T>
+struct not_equal_to_value
+{
+    T value;
+
+    template <typename U>
+    bool operator()(const U& x) const
+    {
+        return !(x == value);
+    }
+};
+
+}
+
+namespace view
+{
+
+template <typename Func, typename Range>
+class map_view
+{
+    private:
+        typedef detail::range_iterator_t<Range> base_iterator;
+
+        Func func_;
+        Range range_;
+
+    public:
+        class iterator
+        {
+            public:
+                typedef detail::view_iterator_category<base_iterator> iterator_category;
+                typedef decltype(std::declval<Func&>()(
+                    std::declval<detail::range_reference_t<base_iterator>>())) reference;
+                typedef decay_t<reference> value_type;
+                typedef ptrdiff_t difference_type;
+                typedef void pointer;
+
+                iterator() {}
+
+                iterator(Func* func, base_iterator it)
+                : func_(func), it_(it) {}
+
+                reference operator*() const { return (*func_)(*it_); }
+
+                iterator& operator++()
+                {
+                    ++it_;
+                    return *this;
+                }
+
+                iterator operator++(int)
+                {
+                    iterator old(*this);
+                    ++it_;
+                    return old;
+                }
+
+                bool operator==(const iterator& other) const { return it_ == other.it_; }
+
+                bool operator!=(const iterator& other) const { return it_ != other.it_; }
+
+            private:
+                Func* func_ = nullptr;
+                base_iterator it_;
+        };
+
+        typedef typename iterator::value_type value_type;
+
+        map_view(Func func, Range&& range)
+        : func_(std::move(func)), range_(std::forward<Range>(range)) {}
+
+        iterator begin() { return iterator(&func_, range_.begin()); }
+
+        iterator end() { return iterator(&func_, range_.end()); }
+
+        size_t size_hint() { return detail::range_size_hint(range_); }
+};
+
+template <typename Predicate, typename Range>
+class filter_view
+{
+    private:
+        typedef detail::range_iterator_t<Range> base_iterator;
+
+        Predicate pred_;
+        Range range_;
+
+    public:
+        class iterator
+        {
+            public:
+                typedef detail::view_iterator_category<base_iterator> iterator_category;
+                typedef detail::range_reference_t<base_iterator> reference;
+                typedef decay_t<reference> value_type;
+                typedef ptrdiff_t difference_type;
+                typedef void pointer;
+
+                iterator() {}
+
+                iterator(Predicate* pred, base_iterator it, base_iterator end)
+                : pred_(pred), it_(it), end_(end)
+                {
+                    skip();
+                }
+
+                reference operator*() const { return *it_; }
+
+                iterator& operator++()
+                {
+                    ++it_;
+                    skip();
+                    return *this;
+                }
+
+                iterator operator++(int)
+                {
+                    iterator old(*this);
+                    ++*this;
+                    return old;
+                }
+
+                bool operator==(const iterator& other) const { return it_ == other.it_; }
+
+                bool operator!=(const iterator& other) const { return it_ != other.it_; }
+
+            private:
+                Predicate* pred_ = nullptr;
+                base_iterator it_;
+                base_iterator end_;
+
+                void skip()
+                {
+                    while (it_ != end_ && !(*pred_)(*it_)) ++it_;
+                }
+        };
+
+        typedef typename iterator::value_type value_type;
+
+        filter_view(Predicate pred, Range&& range)
+        : pred_(std::move(pred)), range_(std::forward<Range>(range)) {}
+
+        iterator begin() { return iterator(&pred_, range_.begin(), range_.end()); }
+
+        iterator end() { return iterator(&pred_, range_.end(), range_.end()); }
+
+};
+
+template <typename... Ranges>
+class zip_view
+{
+    private:
+        typedef std::tuple<detail::range_iterator_t<Ranges>...> base_iterators;
+        typedef std::index_sequence_for<Ranges...> indices;
+
+        std::tuple<Ranges...> ranges_;
+
+        template <size_t... I>
+        base_iterators begins(std::index_sequence<I...>)
+        {
+            return base_iterators(std::get<I>(ranges_).begin()...);
+        }
+
+        template <size_t... I>
+        base_iterators ends(std::index_sequence<I...>)
+        {
+            return base_iterators(std::get<I>(ranges_).end()...);
+        }
+
+        template <size_t... I>
+        size_t size_hint(std::index_sequence<I...>)
+        {
+            size_t sizes[] = {detail::range_size_hint(std::get<I>(ranges_))...};
+            return *std::min_element(sizes, sizes+sizeof...(I));
+        }
+
+    public:
+        class iterator
+        {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef std::tuple<detail::range_reference_t<
+                    detail::range_iterator_t<Ranges>>...> reference;
+                typedef std::tuple<decay_t<detail::range_reference_t<
+                    detail::range_iterator_t<Ranges>>>...> value_type;
+                typedef ptrdiff_t difference_type;
+                typedef void pointer;
+
+                iterator() {}
+
+                explicit iterator(const base_iterators& its) : its_(its) {}
+
+                reference operator*() const { return deref(indices()); }
+
+                iterator& operator++()
+                {
+                    increment(indices());
+                    return *this;
+                }
+
+                iterator operator++(int)
+                {
+                    iterator old(*this);
+                    increment(indices());
+                    return old;
+                }
+
+                /*
+                 * Iterators compare equal as soon as any of their
+                 * components do, so that iteration stops at the end of the
+                 * shortest range.
+                 */
+                bool operator==(const iterator& other) const
+                {
+                    return any_equal(other, indices());
+                }
+
+                bool operator!=(const iterator& other) const
+                {
+                    return !any_equal(other, indices());
+                }
+
+            private:
+                base_iterators its_;
+
+                template <size_t... I>
+                reference deref(std::index_sequence<I...>) const
+                {
+                    return reference(*std::get<I>(its_)...);
+                }
+
+                template <size_t... I>
+                void increment(std::index_sequence<I...>)
+                {
+                    int expand[] = {0, (++std::get<I>(its_), 0)...};
+                    (void)expand;
+                }
+
+                template <size_t... I>
+                bool any_equal(const iterator& other, std::index_sequence<I...>) const
+                {
+                    bool equal[] = {false, (std::get<I>(its_) == std::get<I>(other.its_))...};
+                    return std::find(equal, equal+sizeof...(I)+1, true) != equal+sizeof...(I)+1;
+                }
+        };
+
+        typedef typename iterator::value_type value_type;
+
+        explicit zip_view(Ranges&&... ranges)
+        : ranges_(std::forward<Ranges>(ranges)...) {}
+
+        iterator begin() { return iterator(begins(indices())); }
+
+        iterator end() { return iterator(ends(indices())); }
+
+        size_t size_hint() { return size_hint(indices()); }
+};
+
+/*
+ * func(x) for each element x of range, computed when it is read.
+ */
+template <typename Func, typename Range>
+map_view<decay_t<Func>,Range> map(Func&& func, Range&& range)
+{
+    return map_view<decay_t<Func>,Range>(std::forward<Func>(func),
+                                         std::forward<Range>(range));
+}
+
+/*
+ * The elements x of range for which pred(x) holds.
+ */
+template <typename Range, typename Predicate>
+filter_view<decay_t<Predicate>,Range> filter(Range&& range, Predicate&& pred)
+{
+    return filter_view<decay_t<Predicate>,Range>(std::forward<Predicate>(pred),
+                                                 std::forward<Range>(range));
+}
+
+/*
+ * The elements x of range for which f(x) does not hold, or which are not
+ * equal to f if it is an element.
+ */
+template <typename Range, typename Functor>
+enable_if_not_same_t<typename decay_t<Range>::value_type,decay_t<Functor>,
+                     filter_view<detail::not_fn<decay_t<Functor>>,Range>>
+erase(Range&& range, Functor&& f)
+{
+    return filter_view<detail::not_fn<decay_t<Functor>>,Range>(
+        {std::forward<Functor>(f)}, std::forward<Range>(range));
+}
+
+template <typename Range>
+filter_view<detail::not_equal_to_value<typename decay_t<Range>::value_type>,Range>
+erase(Range&& range, const typename decay_t<Range>::value_type& e)
+{
+    return filter_view<detail::not_equal_to_value<typename decay_t<Range>::value_type>,Range>(
+        {e}, std::forward<Range>(range));
+}
+
+/*
+ * Tuples of corresponding elements of the ranges, as long as the shortest.
+ */
+template <typename... Ranges>
+zip_view<Ranges...> zip(Ranges&&... ranges)
+{
+    return zip_view<Ranges...>(std::forward<Ranges>(ranges)...);
+}
+
+/*
+ * Materialize a range (usually a chain of views) as a Container, by
+ * default a std::vector of its value type, reserving space once when its
+ * size is known.
+ */
+template <typename Container=void, typename Range>
+conditional_t<std::is_void<Container>::value,
+              std::vector<typename decay_t<Range>::value_type>,Container>
+collect(Range&& range)
+{
+    typedef conditional_t<std::is_void<Container>::value,
+                          std::vector<typename decay_t<Range>::value_type>,
+                          Container> result;
+
+    result c;
+    detail::reserve(c, detail::range_size_hint(range), 0);
+    for (auto&& x : range) c.emplace_back(std::forward<decltype(x)>(x));
+    return c;
+}
+
+}
+
+}
+
+#endif
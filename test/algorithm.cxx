@@ -1,6 +1,14 @@
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <functional>
+#include <iterator>
 #include <vector>
 #include <list>
+#include <set>
+#include <string>
 
 #include "gtest/gtest.h"
 
@@ -114,6 +122,131 @@ TEST(unit_algorithm, filter)
     vector<int> v2 = filtered(v, [](int x){return x > 4;});
     EXPECT_EQ(vector<int>({1,3,5,7,9}), v);
     EXPECT_EQ(vector<int>({5,7,9}), v2);
+
+    vector<string> s = {"a","bb","c","dd","e"};
+    EXPECT_EQ(vector<string>({"bb","dd"}), filter(s, [](const string& x){return x.size() > 1;}));
+
+    string str = "filter out vowels";
+    EXPECT_EQ("fltr t vwls", filter(str, [](char c){return !strchr("aeiou", c);}));
+}
+
+TEST(unit_algorithm, char_set)
+{
+    EXPECT_EQ("hll wrld", erased(string("hello world"), "eo"));
+    EXPECT_EQ("hellwrld", erased(string("hello world"), string("xo ")));
+    EXPECT_EQ("", erased(string("aaaa"), "a"));
+    EXPECT_EQ("abc", erased(string("abc"), ""));
+
+    string s = "a\xff\x80" "b\x7f";
+    EXPECT_EQ("ab", erase(s, "\xff\x80\x7f"));
+
+    vector<char> v = {'x','1','y','2'};
+    EXPECT_EQ(vector<char>({'1','2'}), filter(v, make_char_set([](char c){return c >= '0' && c <= '9';})));
+    deque<char> d = {'x','1','y','2'};
+    EXPECT_EQ(deque<char>({'x','y'}), erased(d, char_set("0123456789")));
+    EXPECT_EQ(deque<char>({'1','2'}), filtered(d, char_set("0123456789")));
+
+    char_set all = make_char_set([](char){return true;});
+    EXPECT_TRUE(all.contains('\0'));
+    EXPECT_TRUE(all.contains(char(255)));
+
+    for (size_t n : {0, 1, 31, 32, 33, 63, 64, 65, 100, 1000, 4099})
+    {
+        string in(n, ' ');
+        for (size_t i = 0;i < n;i++) in[i] = char(i*7919 % 256);
+
+        for (const char* e : {"", "a", "\x80\x81\xff\x01", "0123456789abcdefABCDEF \x7f"})
+        {
+            string expected;
+            for (char c : in) if (!strchr(e, c) || c == 0) expected += c;
+            EXPECT_EQ(expected, erased(in, e));
+        }
+
+        string kept;
+        for (char c : in) if (c & 1) kept += c;
+        EXPECT_EQ(kept, filtered(in, make_char_set([](char c){return c & 1;})));
+    }
+}
+
+template <typename U>
+void check_compaction(size_t n)
+{
+    vector<U> v(n);
+    for (size_t i = 0;i < n;i++) v[i] = U(i*7919 % 1000);
+
+    auto keep = [](U x) { return long(std::real(x))%3 != 1; };
+    vector<U> expected;
+    vector<char> bytes(n);
+    vector<bool> bools(n);
+    vector<uint8_t> packed8((n+7)/8);
+    vector<uint64_t> packed64((n+63)/64);
+    for (size_t i = 0;i < n;i++)
+    {
+        bytes[i] = bools[i] = keep(v[i]);
+        if (keep(v[i]))
+        {
+            expected.push_back(v[i]);
+            packed8[i/8] |= uint8_t(1u << (i%8));
+            packed64[i/64] |= uint64_t(1) << (i%64);
+        }
+    }
+
+    EXPECT_EQ(expected, filtered(v, keep)) << n;
+    EXPECT_EQ(expected, masked(v, bytes)) << n;
+    EXPECT_EQ(expected, masked(v, bools)) << n;
+    EXPECT_EQ(expected, masked(packed_bits, v, packed8)) << n;
+    EXPECT_EQ(expected, masked(packed_bits, v, packed64)) << n;
+
+    vector<U> out(n/2+3, U(7));
+    EXPECT_EQ(expected, filtered(v, keep, out)) << n;
+    out.assign(n+5, U(7));
+    EXPECT_EQ(expected, masked(v, bytes, out)) << n;
+    out.clear();
+    EXPECT_EQ(expected, masked(packed_bits, v, packed8, out)) << n;
+
+    vector<U> copy(n, U(7));
+    EXPECT_EQ(expected.size(), size_t(filter_copy(v, keep, copy.begin())-copy.begin())) << n;
+    copy.resize(expected.size());
+    EXPECT_EQ(expected, copy) << n;
+    copy.clear();
+    mask_copy(v, bools, back_inserter(copy));
+    EXPECT_EQ(expected, copy) << n;
+    copy.clear();
+    mask_copy(packed_bits, v, packed64, back_inserter(copy));
+    EXPECT_EQ(expected, copy) << n;
+}
+
+TEST(unit_algorithm, compaction)
+{
+    for (size_t n : {0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 1000, 4099})
+    {
+        check_compaction<char>(n);
+        check_compaction<int16_t>(n);
+        check_compaction<int>(n);
+        check_compaction<float>(n);
+        check_compaction<int64_t>(n);
+        check_compaction<double>(n);
+        check_compaction<complex<double>>(n);
+    }
+
+    vector<int64_t> word(64);
+    for (size_t i = 0;i < word.size();i++) word[i] = i;
+    EXPECT_EQ(word, filtered(word, [](int64_t){return true;}));
+    vector<int64_t> odd;
+    for (int64_t i = 1;i < 64;i += 2) odd.push_back(i);
+    EXPECT_EQ(odd, filtered(word, [](int64_t x){return x%2 != 0;}));
+    vector<int> iword(word.begin(), word.end());
+    EXPECT_EQ(vector<int>(odd.begin(), odd.end()),
+              filtered(iword, [](int x){return x%2 != 0;}));
+
+    vector<int> v(100, 1);
+    EXPECT_EQ(100u, filtered(v, [](int){return true;}).size());
+    EXPECT_EQ(0u, filtered(v, [](int){return false;}).size());
+
+    vector<string> s = {"a","b","c","d","e"};
+    EXPECT_EQ(vector<string>({"a","d","e"}), masked(packed_bits, s, vector<uint8_t>({0x19})));
+    vector<bool> b = {true,false,true,true};
+    EXPECT_EQ(vector<bool>({false,true}), masked(b, vector<int>({0,1,1,0})));
 }
 
 TEST(unit_algorithm, apply)
@@ -123,6 +256,59 @@ TEST(unit_algorithm, apply)
     EXPECT_EQ(vector<double>({1.0,3.0,9.0,27.0,81.0}), v2);
 }
 
+TEST(unit_algorithm, map)
+{
+    vector<int> v = {0,1,2,3,4};
+    EXPECT_EQ(vector<int>({0,2,4,6,8}), stl_ext::map([](int x){return 2*x;}, v));
+    EXPECT_EQ(vector<double>({0,0.5,1,1.5,2}), stl_ext::map([](int x){return x/2.0;}, v));
+    EXPECT_EQ(vector<int>({0,1,2,3,4}), v);
+
+    vector<int> v2 = v;
+    const int* data = v2.data();
+    vector<int> v3 = stl_ext::map([](int x){return x+1;}, std::move(v2));
+    EXPECT_EQ(vector<int>({1,2,3,4,5}), v3);
+    EXPECT_EQ(data, v3.data());
+
+    EXPECT_EQ(vector<int>({0,1,4,9,16}), transform(v, [](int x){return x*x;}));
+    EXPECT_EQ(vector<int>({0,1,4,9,16}), v);
+
+    list<int> l = {1,2,3};
+    EXPECT_EQ(list<int>({2,3,4}), stl_ext::map(par, [](int x){return x+1;}, l));
+    EXPECT_EQ(list<int>({-1,-2,-3}), transform(par(2), l, [](int x){return -x;}));
+
+    vector<bool> b = {true,false,true};
+    EXPECT_EQ(vector<bool>({false,true,false}), stl_ext::map(par, [](bool x){return !x;}, b));
+    EXPECT_EQ(vector<bool>({true,false,true}),
+              stl_ext::map(par, [](int x){return x%2 == 1;}, vector<int>({1,2,3})));
+
+    size_t n = 100000;
+    vector<int64_t> big(n);
+    for (size_t i = 0;i < n;i++) big[i] = i;
+    auto sq = [](int64_t x){return x*x;};
+    auto half = [](int64_t x){return x/2.0;};
+
+    for (unsigned nt : {1, 3, 8})
+    {
+        auto squares = stl_ext::map(par(nt), sq, big);
+        auto halves = stl_ext::map(par(nt), half, big);
+        for (size_t i = 0;i < n;i++)
+        {
+            ASSERT_EQ(int64_t(i)*int64_t(i), squares[i]);
+            ASSERT_EQ(i/2.0, halves[i]);
+        }
+
+        vector<int64_t> moved = big;
+        const int64_t* p = moved.data();
+        auto squares2 = stl_ext::map(par(nt), sq, std::move(moved));
+        EXPECT_EQ(squares, squares2);
+        EXPECT_EQ(p, squares2.data());
+
+        vector<int64_t> inplace = big;
+        transform(par(nt), inplace, sq);
+        EXPECT_EQ(squares, inplace);
+    }
+}
+
 TEST(unit_algorithm, sum)
 {
     vector<int> v = {0,1,2,3,4};
@@ -137,6 +323,78 @@ TEST(unit_algorithm, contains)
     EXPECT_EQ(false, contains(v, -10));
 }
 
+TEST(unit_algorithm, find)
+{
+    string s = "the quick brown fox";
+    EXPECT_EQ(s.begin()+4, find(s, 'q'));
+    EXPECT_EQ(s.end(), find(s, 'z'));
+    EXPECT_EQ(s.begin()+10, find(s, "brown"));
+    EXPECT_EQ(s.begin()+10, find(s, string("brown")));
+    EXPECT_EQ(s.begin()+16, find(s, "foxes", 3));
+    EXPECT_EQ(s.end(), find(s, "foxes"));
+    EXPECT_EQ(s.begin(), find(s, ""));
+    EXPECT_TRUE(contains(s, "fox"));
+    EXPECT_TRUE(contains(s, list<char>{'o','w'}));
+    EXPECT_FALSE(contains(s, "dog"));
+    EXPECT_EQ(10, index_of(s, "brown"));
+
+    vector<int> v = {1,2,3,1,2,4};
+    EXPECT_EQ(v.begin()+3, find(v, vector<int>{1,2,4}));
+    EXPECT_TRUE(contains(v, v.data()+1, 2));
+    EXPECT_FALSE(contains(v, vector<int>{2,1}));
+
+    vector<string> words = {"a","bc"};
+    EXPECT_EQ(words.begin()+1, find(words, "bc"));
+    EXPECT_TRUE(contains(words, string("a")));
+
+    for (size_t n : {0, 1, 2, 31, 32, 33, 63, 64, 65, 100, 1000, 4099})
+    {
+        string h(n, 'a');
+        for (size_t i = 0;i < n;i++) h[i] = "ab"[(i*7919/3) % 2];
+
+        for (const char* needle : {"a", "ab", "ba", "aab", "abba", "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb", "c", "ac"})
+        {
+            auto expected = std::search(h.begin(), h.end(), needle, needle+strlen(needle));
+            EXPECT_EQ(expected-h.begin(), find(h, needle)-h.begin()) << n << " " << needle;
+        }
+
+        string t = h+"xyzzy"+h;
+        EXPECT_EQ(n, size_t(find(t, "xyzzy")-t.begin()));
+    }
+}
+
+TEST(unit_algorithm, starts_and_ends_with)
+{
+    string s = "prefix.suffix";
+    EXPECT_TRUE(starts_with(s, "pre"));
+    EXPECT_FALSE(starts_with(s, "prefix.suffix.more"));
+    EXPECT_TRUE(starts_with(s, string("prefix")));
+    EXPECT_TRUE(starts_with(s, "prefab", 4));
+    EXPECT_FALSE(starts_with(s, "prefab", 5));
+    EXPECT_TRUE(starts_with(s, 'p'));
+    EXPECT_TRUE(starts_with(s, ""));
+
+    EXPECT_TRUE(ends_with(s, "fix"));
+    EXPECT_FALSE(ends_with(s, "x.prefix.suffix"));
+    EXPECT_TRUE(ends_with(s, string(".suffix")));
+    EXPECT_TRUE(ends_with(s, "fixes", 3));
+    EXPECT_FALSE(ends_with(s, "fixes", 4));
+    EXPECT_TRUE(ends_with(s, 'x'));
+
+    vector<int> v = {1,2,3,4};
+    EXPECT_TRUE(starts_with(v, vector<int>{1,2}));
+    EXPECT_FALSE(starts_with(v, vector<int>{2}));
+    EXPECT_TRUE(ends_with(v, list<int>{3,4}));
+    EXPECT_TRUE(ends_with(v, v.data()+2, 2));
+
+    list<int> l = {1,2,3};
+    EXPECT_TRUE(starts_with(l, vector<int>{1,2}));
+    EXPECT_TRUE(ends_with(l, list<int>{2,3}));
+
+    vector<double> d = {-0.0, 1.0};
+    EXPECT_TRUE(starts_with(d, vector<double>{0.0}));
+}
+
 TEST(unit_algorithm, sort)
 {
     vector<int> v = {0,6,2,-1,4};
@@ -155,6 +413,98 @@ TEST(unit_algorithm, unique)
     EXPECT_EQ(vector<int>({-2,1,2,3,6,7,134,4506}), uniqued(v));
     EXPECT_EQ(vector<int>({1,2,3,7,-2,6,1,4506,2,134,2}), v);
     EXPECT_EQ(vector<int>({-2,1,2,3,6,7,134,4506}), unique(v));
+
+    vector<int> w = {1,2,3,7,-2,6,1,4506,2,134,2};
+    EXPECT_EQ(vector<int>({1,2,3,7,-2,6,4506,134}), hash_uniqued(w));
+    EXPECT_EQ(vector<int>({1,2,3,7,-2,6,4506,134}), hash_unique(w));
+    EXPECT_EQ(vector<int>({1,2,3,7,-2,6,4506,134}), hash_uniqued(par, w));
+
+    vector<string> s = {"b","a","b","c","a"};
+    EXPECT_EQ(vector<string>({"a","b","c"}), uniqued(s));
+    EXPECT_EQ(vector<string>({"a","b","c"}), uniqued(par, s));
+    EXPECT_EQ(vector<string>({"b","a","c"}), hash_uniqued(s));
+    EXPECT_EQ(vector<string>({"b","a","c"}), hash_uniqued(par(3), s));
+
+    EXPECT_EQ(vector<bool>({false,true}), uniqued(par, vector<bool>({true,false,true})));
+    EXPECT_EQ(vector<int>(), uniqued(vector<int>()));
+    EXPECT_EQ(vector<int>(), hash_uniqued(par, vector<int>()));
+
+    for (size_t n : {1000, 100000})
+    {
+        vector<int64_t> big(n);
+        for (size_t i = 0;i < n;i++) big[i] = int64_t((i*7919)%(n/3))-int64_t(n/7);
+
+        vector<int64_t> sorted_expected = big;
+        std::sort(sorted_expected.begin(), sorted_expected.end());
+        sorted_expected.erase(std::unique(sorted_expected.begin(), sorted_expected.end()),
+                              sorted_expected.end());
+
+        vector<int64_t> first_expected;
+        std::set<int64_t> seen;
+        for (auto x : big) if (seen.insert(x).second) first_expected.push_back(x);
+
+        EXPECT_EQ(sorted_expected, uniqued(big));
+        EXPECT_EQ(first_expected, hash_uniqued(big));
+
+        for (unsigned nt : {2, 3, 8})
+        {
+            EXPECT_EQ(sorted_expected, uniqued(par(nt), big));
+            EXPECT_EQ(first_expected, hash_uniqued(par(nt), big));
+        }
+
+        vector<uint8_t> bytes(n);
+        for (size_t i = 0;i < n;i++) bytes[i] = uint8_t(i*37);
+        auto u = uniqued(bytes);
+        EXPECT_EQ(256u, u.size());
+        EXPECT_TRUE(std::is_sorted(u.begin(), u.end()));
+    }
+}
+
+TEST(unit_algorithm, into_and_copy)
+{
+    const vector<int> v = {3,1,4,1,5,9,2,6,5,3};
+    vector<int> out = {7,7,7,7,7,7,7,7,7,7,7,7};
+
+    EXPECT_EQ(vector<int>({3,4,5,9,2,6,5,3}), erased(v, 1, out));
+    EXPECT_EQ(vector<int>({4,5,9,6,5}), erased(v, [](int x){return x < 4;}, out));
+    EXPECT_EQ(vector<int>({1,1,2,3,3,4,5,5,6,9}), sorted(v, out));
+    EXPECT_EQ(vector<int>({9,6,5,5,4,3,3,2,1,1}), sorted(v, greater<int>(), out));
+    EXPECT_EQ(vector<int>({1,2,3,4,5,6,9}), uniqued(v, out));
+    EXPECT_EQ(vector<int>({1,2,3,4,5,6,9}), uniqued(par(2), v, out));
+    EXPECT_EQ(vector<int>({3,0,4,0,5,9,2,6,5,3}), translated(v, vector<int>{1}, vector<int>{0}, out));
+    EXPECT_EQ(vector<int>({0,2,3,4,5,6,9}), sorted(uniqued(out, out), out));
+
+    vector<int> copy;
+    erase_copy(v, 5, back_inserter(copy));
+    EXPECT_EQ(vector<int>({3,1,4,1,9,2,6,3}), copy);
+    copy.clear();
+    erase_copy(v, [](int x){return x%2;}, back_inserter(copy));
+    EXPECT_EQ(vector<int>({4,2,6}), copy);
+
+    copy.assign(12, 0);
+    EXPECT_EQ(copy.begin()+10, sort_copy(v, copy.begin()));
+    EXPECT_EQ(vector<int>({1,1,2,3,3,4,5,5,6,9,0,0}), copy);
+    EXPECT_EQ(copy.begin()+10, sort_copy(v, copy.begin(), greater<int>()));
+    EXPECT_EQ(vector<int>({9,6,5,5,4,3,3,2,1,1,0,0}), copy);
+    EXPECT_EQ(copy.begin()+7, unique_copy(v, copy.begin()));
+    EXPECT_EQ(vector<int>({1,2,3,4,5,6,9}), vector<int>(copy.begin(), copy.begin()+7));
+    EXPECT_EQ(copy.begin()+10, translate_copy(v, vector<int>{1,9}, vector<int>{-1,-9}, copy.begin()));
+    EXPECT_EQ(vector<int>({3,-1,4,-1,5,-9,2,6,5,3}), vector<int>(copy.begin(), copy.begin()+10));
+
+    string s = "hello, world";
+    string buf(64, '*');
+    EXPECT_EQ("hll, wrld", erased(s, char_set("aeiou"), buf));
+    EXPECT_EQ("eoo", filtered(s, char_set("aeiou"), buf));
+    EXPECT_EQ("jello, world", translated(s, make_translator(string("h"), string("j")), buf));
+    buf.resize(s.size());
+    EXPECT_EQ(buf.end(), translate_copy(s, make_translator(string("lo"), string("LO")), buf.begin()));
+    EXPECT_EQ("heLLO, wOrLd", buf);
+
+    vector<string> words = {"b","a","c","a"};
+    vector<string> wout(1, "x");
+    EXPECT_EQ(vector<string>({"b","c"}), erased(words, string("a"), wout));
+    EXPECT_EQ(vector<string>({"a","a"}), filtered(words, [](const string& x){return x == "a";}, wout));
+    EXPECT_EQ(vector<string>({"a","b","c"}), uniqued(words, wout));
 }
 
 TEST(unit_algorithm, intersect)
@@ -207,4 +557,508 @@ TEST(unit_algorithm, translate)
     EXPECT_EQ(vector<int>({0,1,-2,3,-4,5,-6}), translated(v, from, to));
     EXPECT_EQ(vector<int>({0,1,2,3,4,5,6}), v);
     EXPECT_EQ(vector<int>({0,1,-2,3,-4,5,-6}), translate(v, from, to));
+
+    vector<char> c = {'b','o','o','t','h','s'};
+    EXPECT_EQ(vector<char>({'h','o','o','p','l','e'}),
+              translated(c, vector<char>({'b','h','s','t','s'}),
+                            vector<char>({'h','l','x','p','e'})));
+
+    vector<int> sparse = {1000000,-7,3,1000000};
+    EXPECT_EQ(vector<int>({5,-7,-3,5}),
+              translated(sparse, vector<int>({3,1000000,8}), vector<int>({-3,5,0})));
+
+    vector<unsigned> wide = {0u,~0u,5u};
+    EXPECT_EQ(vector<unsigned>({1u,2u,5u}),
+              translated(wide, vector<unsigned>({0u,~0u}), vector<unsigned>({1u,2u})));
+
+    vector<long> lv = {-3,100,4,1};
+    EXPECT_EQ(vector<long>({-3,100,-4,-1}),
+              translated(lv, make_translator(vector<int>({4,1,2}), vector<int>({-4,-1,-2}))));
+
+    vector<double> dv = {2.5,2,3,-1e30,1e30};
+    EXPECT_EQ(vector<double>({2.5,20,30,-1e30,1e30}),
+              translated(dv, vector<int>({2,3}), vector<int>({20,30})));
+    EXPECT_EQ(vector<double>({2.5,20,3,-1e30,1e30}),
+              translated(dv, vector<int>({2,1000000}), vector<int>({20,30})));
+
+    vector<long long> ll = {4294967296LL,0,1000000,-4294967296LL};
+    EXPECT_EQ(vector<long long>({4294967296LL,-1,-2,-4294967296LL}),
+              translated(ll, vector<int>({0,1000000}), vector<int>({-1,-2})));
+    EXPECT_EQ(vector<long long>({4294967296LL,-1,1000000,-4294967296LL}),
+              translated(ll, vector<int>({0,1}), vector<int>({-1,3})));
+
+    vector<string> s = {"x","y","z","y"};
+    auto trans = make_translator(vector<string>({"y","z"}), vector<string>({"Y","Z"}));
+    EXPECT_EQ(vector<string>({"x","Y","Z","Y"}), translated(s, trans));
+    translate(s, trans);
+    EXPECT_EQ(vector<string>({"x","Y","Z","Y"}), s);
+
+    vector<pair<int,int>> p = {{1,2},{3,4},{5,6}};
+    EXPECT_EQ((vector<pair<int,int>>({{1,2},{0,0},{5,6}})),
+              translated(p, vector<pair<int,int>>({{3,4},{7,7},{3,4}}),
+                            vector<pair<int,int>>({{9,9},{8,8},{0,0}})));
+
+    translator<int> none{vector<int>(), vector<int>()};
+    EXPECT_EQ(vector<int>({0,1,2,3,4,5,6}), translated(vector<int>({0,1,2,3,4,5,6}), none));
+}
+
+TEST(unit_algorithm, hash_set_ops)
+{
+    vector<int> v1 = {6,1,3,1,0,5,2};
+    vector<int> v2 = {11,1,9,3,7,5,3};
+
+    vector<int> v3 = v1;
+    EXPECT_EQ(vector<int>({1,3,5}), hash_intersect(v3, v2));
+    v3 = v1;
+    EXPECT_EQ(vector<int>({6,1,0,2}), hash_exclude(v3, v2));
+    v3 = v1;
+    EXPECT_EQ(vector<int>({6,1,3,1,0,5,2,11,9,7,3}), hash_unite(v3, v2));
+    EXPECT_EQ(vector<int>({6,1,0,2,11,9,7,3}), hash_mutual_exclusion(v1, v2));
+
+    vector<int> big(1000);
+    for (size_t i = 0;i < big.size();i++) big[i] = (i*7919)%1009;
+    vector<int> small = {5,2000,17,5,-3,1008};
+
+    EXPECT_EQ(vector<int>({5,17,1008}), intersection(big, small));
+    EXPECT_EQ(vector<int>({5,17,1008}), intersection(small, big));
+    EXPECT_EQ(vector<int>({-3,5,2000}), exclusion(small, big));
+    vector<int> ex = exclusion(big, small);
+    EXPECT_EQ(997u, ex.size());
+    EXPECT_TRUE(is_sorted(ex.begin(), ex.end()));
+
+    vector<int> v4 = small;
+    EXPECT_EQ(vector<int>({5,17,1008}), intersect(v4, vector<int>(big)));
+}
+
+TEST(unit_algorithm, sorted_set_ops)
+{
+    vector<int> v1 = {0,1,1,2,3,4,5,6};
+    vector<int> v2 = {1,3,5,5,7,9,11};
+
+    vector<int> v3 = v1;
+    EXPECT_EQ(vector<int>({1,3,5}), sorted_intersect(v3, v2));
+    v3 = v1;
+    EXPECT_EQ(vector<int>({0,1,2,4,6}), sorted_exclude(v3, v2));
+    v3 = v1;
+    EXPECT_EQ(vector<int>({0,1,1,2,3,4,5,5,6,7,9,11}), sorted_unite(v3, v2));
+    EXPECT_EQ(vector<int>({0,1,2,4,5,6,7,9,11}), sorted_mutual_exclusion(v1, v2));
+
+    vector<int> big;
+    for (int i = 0;i < 1000;i++) big.push_back(2*i);
+    vector<int> small = {-2,4,5,4,1000,1998,2000};
+    sort(small);
+
+    v3 = big;
+    EXPECT_EQ(vector<int>({4,1000,1998}), sorted_intersect(v3, small));
+    v3 = small;
+    EXPECT_EQ(vector<int>({4,1000,1998}), sorted_intersect(v3, big));
+
+    v3 = big;
+    sorted_exclude(v3, small);
+    EXPECT_EQ(997u, v3.size());
+    EXPECT_TRUE(is_sorted(v3.begin(), v3.end()));
+    EXPECT_FALSE(binary_search(v3.begin(), v3.end(), 1000));
+    v3 = small;
+    EXPECT_EQ(vector<int>({-2,4,5,2000}), sorted_exclude(v3, big));
+
+    v3 = big;
+    sorted_unite(v3, small);
+    EXPECT_EQ(1004u, v3.size());
+    EXPECT_TRUE(is_sorted(v3.begin(), v3.end()));
+    EXPECT_EQ(-2, v3.front());
+    EXPECT_EQ(2000, v3.back());
+
+    vector<int> v4 = {5,1,3};
+    EXPECT_EQ(vector<int>({1,2,3,5,7}), unite(v4, vector<int>({7,2,1})));
+
+    deque<int> d1(v1.begin(), v1.end()), d2(v2.begin(), v2.end());
+    deque<int> d3 = d1;
+    EXPECT_EQ(deque<int>({0,1,1,2,3,4,5,5,6,7,9,11}), sorted_unite(d3, d2));
+    d3 = d1;
+    EXPECT_EQ(deque<int>({1,3,5}), sorted_intersect(d3, d2));
+    d3 = d1;
+    EXPECT_EQ(deque<int>({0,1,2,4,6}), sorted_exclude(d3, d2));
+    deque<int> d4 = {5,1,3};
+    EXPECT_EQ(deque<int>({1,2,3,5,7}), unite(d4, deque<int>({7,2,1})));
+    d4 = {5,1,3};
+    EXPECT_EQ(deque<int>({1,3}), intersect(d4, deque<int>({7,3,1})));
+}
+
+TEST(unit_algorithm, multi_set_ops)
+{
+    vector<int> v1 = {5,1,3,3,9,7,3};
+    vector<int> v2 = {3,3,1,4,9,8};
+    vector<int> v3 = {9,3,2,1,3,3,0};
+
+    EXPECT_EQ(vector<int>({1,3,3,9}), intersection(v1, v2, v3));
+    EXPECT_EQ(vector<int>({0,1,2,3,3,3,4,5,7,8,9}), union_of(v1, v2, v3));
+    EXPECT_EQ(vector<int>({}), intersection(v1, v2, vector<int>()));
+    EXPECT_EQ(vector<int>({1,3,3,4,8,9}), union_of(vector<int>(), vector<int>({9,3}), v2));
+
+    deque<int> d1(v1.begin(), v1.end()), d2(v2.begin(), v2.end()), d3(v3.begin(), v3.end());
+    EXPECT_EQ(deque<int>({1,3,3,9}), intersection(d1, d2, d3));
+    EXPECT_EQ(deque<int>({0,1,2,3,3,3,4,5,7,8,9}), union_of(d1, d2, d3));
+
+    vector<vector<int>> vs(4);
+    for (size_t j = 0;j < vs.size();j++)
+        for (int i = 0;i < 500;i++) vs[j].push_back((i*(j+3)*7919)%211);
+
+    vector<int> pairwise_i = vs[0], pairwise_u = vs[0];
+    for (size_t j = 1;j < vs.size();j++)
+    {
+        intersect(pairwise_i, vs[j]);
+        unite(pairwise_u, vs[j]);
+    }
+
+    EXPECT_EQ(pairwise_i, intersection(vs[0], vs[1], vs[2], vs[3]));
+    EXPECT_EQ(pairwise_u, union_of(vs[0], vs[1], vs[2], vs[3]));
+}
+
+TEST(unit_algorithm, simd_reductions)
+{
+    vector<int> vi;
+    vector<double> vd;
+    vector<float> vf;
+    vector<complex<double>> vz;
+    for (int i = 0;i < 10007;i++)
+    {
+        vi.push_back((i*7919)%1009-500);
+        vd.push_back(vi.back()*0.5);
+        vf.push_back(vi.back()*0.25f);
+        vz.push_back({double(i%5), double(i%3)});
+    }
+
+    int si = 0, mini = vi[0], maxi = vi[0];
+    size_t min_posi = 0, max_posi = 0;
+    for (size_t i = 0;i < vi.size();i++)
+    {
+        si += vi[i];
+        if (vi[i] < mini) { mini = vi[i]; min_posi = i; }
+        if (vi[i] > maxi) { maxi = vi[i]; max_posi = i; }
+    }
+
+    EXPECT_EQ(si, sum(vi));
+    EXPECT_EQ(mini, min(vi));
+    EXPECT_EQ(maxi, max(vi));
+    EXPECT_EQ(min_posi, min_pos(vi));
+    EXPECT_EQ(max_posi, max_pos(vi));
+    EXPECT_EQ(si*0.5, sum(vd));
+    EXPECT_EQ(mini*0.5, min(vd));
+    EXPECT_EQ(max_posi, max_pos(vd));
+    EXPECT_EQ(si*0.25f, sum(vf));
+    EXPECT_EQ(maxi*0.25f, max(vf));
+    EXPECT_EQ(min_posi, min_pos(vf));
+
+    complex<double> sz;
+    for (auto& z : vz) sz += z;
+    EXPECT_EQ(sz, sum(vz));
+
+    vector<double> vp(100, 1.0);
+    vp[37] = 2.0;
+    vp[90] = 0.5;
+    EXPECT_EQ(1.0, prod(vp));
+    EXPECT_EQ(4, prod(vector<int>{2,1,2}));
+    EXPECT_EQ(1, prod(vector<int>()));
+
+    vd[5000] = vd[9000] = -1e6;
+    vd[3] = nan("");
+    EXPECT_EQ(-1e6, min(vd));
+    EXPECT_EQ(5000u, min_pos(vd));
+    vd[0] = nan("");
+    EXPECT_EQ(0u, min_pos(vd));
+    EXPECT_TRUE(std::isnan(max(vd)));
+
+    vector<double> w(5000, 1.0);
+    w[2048] = nan("");
+    w[3000] = -1;
+    w[4000] = 2;
+    EXPECT_EQ(3000u, min_pos(w));
+    EXPECT_EQ(4000u, max_pos(w));
+    for (size_t i = 2048;i < 4096;i++) w[i] = nan("");
+    EXPECT_EQ(0u, min_pos(w));
+}
+
+TEST(unit_algorithm, summation_policies)
+{
+    vector<double> v;
+    for (int i = 0;i < 100000;i++) v.push_back(i%2 ? 1e-8 : 1.0);
+    double exact = 50000+50000*1e-8;
+
+    EXPECT_NEAR(exact, sum(v), 1e-6);
+    EXPECT_NEAR(exact, sum(pairwise, v), 1e-8);
+    EXPECT_DOUBLE_EQ(exact, sum(kahan, v));
+    EXPECT_DOUBLE_EQ(exact, sum(blocked, v));
+
+    vector<float> f;
+    for (int i = 0;i < 1000000;i++) f.push_back(0.1f);
+    double exact_f = 1000000*double(0.1f);
+    EXPECT_NEAR(exact_f, sum(pairwise, f), 1e-1);
+    EXPECT_FLOAT_EQ(exact_f, sum(kahan, f));
+    EXPECT_NEAR(exact_f, sum(blocked, f), 1e-1);
+
+    vector<double> cancel = {1e100, 1.0, -1e100, 1.0};
+    EXPECT_EQ(2.0, sum(kahan, cancel));
+    EXPECT_EQ(2.0, sum(kahan, list<double>(cancel.begin(), cancel.end())));
+
+    vector<complex<double>> z(3000, {0.1, -0.3});
+    EXPECT_NEAR(300.0, sum(kahan, z).real(), 1e-12);
+    EXPECT_NEAR(-900.0, sum(pairwise, z).imag(), 1e-10);
+    EXPECT_NEAR(-900.0, sum(blocked, z).imag(), 1e-10);
+
+    EXPECT_EQ(6, sum(kahan, vector<int>{1,2,3}));
+    EXPECT_EQ(0.0, sum(pairwise, vector<double>()));
+}
+
+TEST(unit_algorithm, parallel_reductions)
+{
+    vector<double> v;
+    vector<int> vi;
+    for (int i = 0;i < 300001;i++)
+    {
+        v.push_back(((i*7919LL)%10007)*0.001);
+        vi.push_back((i*7919LL)%10007);
+    }
+    list<int> li(vi.begin(), vi.begin()+1000);
+
+    double s1 = sum(par(1), v);
+    EXPECT_EQ(s1, sum(par(3), v));
+    EXPECT_EQ(s1, sum(par(7), v));
+    EXPECT_NEAR(sum(kahan, v), s1, 1e-6);
+
+    EXPECT_EQ(sum(vi), sum(par(4), vi));
+    EXPECT_EQ(sum(li), sum(par(4), li));
+    EXPECT_EQ(max(vi), max(par(4), vi));
+    EXPECT_EQ(min(v), min(par(4), v));
+    EXPECT_EQ(min(li), min(par, li));
+    EXPECT_EQ(1.0, prod(par(2), vector<double>(200000, 1.0)));
+    EXPECT_EQ(0, sum(par, vector<int>()));
+
+    vector<double> w(200000, 5.0);
+    w[65536] = nan("");
+    w[70000] = -1;
+    w[80000] = 7;
+    EXPECT_EQ(min(w), min(par(2), w));
+    EXPECT_EQ(-1, min(par(2), w));
+    EXPECT_EQ(7, max(par(2), w));
+    deque<double> dw(w.begin(), w.end());
+    EXPECT_EQ(-1, min(par(2), dw));
+    fill(w.begin()+65536, w.begin()+2*65536, nan(""));
+    EXPECT_EQ(5, min(par(2), w));
+    EXPECT_TRUE(std::isnan(sum(par(2), w)));
+
+    EXPECT_EQ(count(vi, 17), count(par(4), vi, 17));
+    EXPECT_EQ(count(li, 17), count(par(4), li, 17));
+    EXPECT_EQ(0, count(par(4), vector<int>(), 17));
+
+    auto odd = [](int x) { return x%2 == 1; };
+    EXPECT_EQ(count_if(vi, odd), count_if(par(4), vi, odd));
+
+    EXPECT_TRUE(contains(par(4), vi, 10006));
+    EXPECT_FALSE(contains(par(4), vi, 10007));
+    EXPECT_TRUE(contains(par(4), li, vi[999]));
+    EXPECT_TRUE(matches(par(4), vi, [](int x) { return x > 10005; }));
+    EXPECT_FALSE(matches(par(4), vi, [](int x) { return x < 0; }));
+    EXPECT_FALSE(matches(par(4), vector<int>(), [](int) { return true; }));
+}
+
+TEST(unit_algorithm, prefix_sum)
+{
+    vector<int> v = {5,1,2,3,4};
+    vector<int> out(5);
+    EXPECT_EQ(out.end(), prefix_sum(v.begin(), v.end(), out.begin(), 10));
+    EXPECT_EQ(vector<int>({10,11,13,16,20}), out);
+    prefix_sum(v.begin(), v.end(), out.begin(), 1, multiplies<int>());
+    EXPECT_EQ(vector<int>({1,1,2,6,24}), out);
+
+    list<int> l(v.begin(), v.end());
+    list<int> lout;
+    prefix_sum(l.begin(), l.end(), back_inserter(lout), 0);
+    EXPECT_EQ(list<int>({0,1,3,6,10}), lout);
+
+    vector<int64_t> big;
+    vector<uint8_t> bytes;
+    for (int i = 0;i < 300001;i++)
+    {
+        big.push_back((i*7919LL)%10007-5000);
+        bytes.push_back(i*31);
+    }
+
+    vector<int64_t> ref(big.size()), out1(big.size()), out2(big.size());
+    int64_t s = 3;
+    ref[0] = s;
+    for (size_t i = 1;i < big.size();i++) ref[i] = s = s+big[i];
+
+    prefix_sum(big.begin(), big.end(), out1.begin(), 3);
+    EXPECT_EQ(ref, out1);
+    prefix_sum(par(3), big.begin(), big.end(), out2.begin(), 3);
+    EXPECT_EQ(ref, out2);
+    prefix_sum(par(4), big.data(), big.data()+big.size(), out2.data(), 3, plus<int64_t>());
+    EXPECT_EQ(ref, out2);
+
+    auto maxop = [](int64_t a, int64_t b) { return std::max(a, b); };
+    prefix_sum(big.begin(), big.end(), ref.begin(), -10000, maxop);
+    prefix_sum(par(5), big.begin(), big.end(), out2.begin(), -10000, maxop);
+    EXPECT_EQ(ref, out2);
+
+    vector<uint8_t> bref(bytes.size()), bout(bytes.size());
+    uint8_t b = 0;
+    bref[0] = 0;
+    for (size_t i = 1;i < bytes.size();i++) bref[i] = b = b+bytes[i];
+    prefix_sum(par(2), bytes.begin(), bytes.end(), bout.begin(), 0);
+    EXPECT_EQ(bref, bout);
+    prefix_sum(bytes.begin(), bytes.end(), bytes.begin(), 0);
+    EXPECT_EQ(bref, bytes);
+
+    vector<double> d(200000, 0.1), d1(d.size()), d2(d.size());
+    prefix_sum(par(1), d.begin(), d.end(), d1.begin(), 0.0);
+    prefix_sum(par(6), d.begin(), d.end(), d2.begin(), 0.0);
+    EXPECT_EQ(d1, d2);
+    EXPECT_NEAR(19999.9, d1.back(), 1e-6);
+}
+
+TEST(unit_algorithm, exclusive_and_segmented_prefix_sum)
+{
+    vector<int> sizes = {3,0,2,5,1};
+    vector<int> offsets(sizes.size());
+    EXPECT_EQ(offsets.end(), exclusive_prefix_sum(sizes.begin(), sizes.end(), offsets.begin(), 0));
+    EXPECT_EQ(vector<int>({0,3,3,5,10}), offsets);
+    exclusive_prefix_sum(sizes.begin(), sizes.end(), sizes.begin(), 1, multiplies<int>());
+    EXPECT_EQ(vector<int>({1,3,0,0,0}), sizes);
+
+    vector<double> x = {1,2,3,4,5,6};
+    vector<bool> flags = {false,false,true,false,true,true};
+    vector<double> out(x.size());
+    segmented_prefix_sum(x.begin(), x.end(), flags.begin(), out.begin());
+    EXPECT_EQ(vector<double>({1,3,3,7,5,6}), out);
+
+    list<char> lflags = {1,0,1,0,1,1};
+    list<double> lout;
+    segmented_prefix_sum(x.begin(), x.end(), lflags.begin(), back_inserter(lout));
+    EXPECT_EQ(list<double>({1,3,3,7,5,6}), lout);
+
+    vector<string> keys = {"a","a","b","b","b","a"};
+    prefix_sum_by_key(keys.begin(), keys.end(), x.begin(), out.begin());
+    EXPECT_EQ(vector<double>({1,3,3,7,12,6}), out);
+
+    list<string> lkeys(keys.begin(), keys.end());
+    prefix_sum_by_key(lkeys.begin(), lkeys.end(), x.begin(), out.begin(), multiplies<double>());
+    EXPECT_EQ(vector<double>({1,2,3,12,60,6}), out);
+
+    vector<int32_t> big, bigkey, ref, res(100003), eref, eres(100003);
+    vector<uint8_t> bigflag;
+    int32_t run = 0, total = 7;
+    for (int i = 0;i < 100003;i++)
+    {
+        big.push_back((i*7919LL)%1009-500);
+        bigkey.push_back(i/13 + (i%29 == 0));
+        bigflag.push_back(i%17 == 3 || i%61 == 0);
+        run = (i == 0 || bigflag[i]) ? big[i] : run+big[i];
+        ref.push_back(run);
+        eref.push_back(total);
+        total += big[i];
+    }
+
+    segmented_prefix_sum(big.begin(), big.end(), bigflag.begin(), res.begin());
+    EXPECT_EQ(ref, res);
+    exclusive_prefix_sum(big.begin(), big.end(), eres.begin(), 7);
+    EXPECT_EQ(eref, eres);
+
+    for (size_t i = 0;i < big.size();i++)
+        ref[i] = (i == 0 || bigkey[i] != bigkey[i-1]) ? big[i] : ref[i-1]+big[i];
+    prefix_sum_by_key(bigkey.begin(), bigkey.end(), big.begin(), res.begin());
+    EXPECT_EQ(ref, res);
+    prefix_sum_by_key(bigkey.begin(), bigkey.end(), big.begin(), big.begin());
+    EXPECT_EQ(ref, big);
+}
+
+TEST(unit_algorithm, permute)
+{
+    vector<string> v = {"a","b","c","d","e","f"};
+    vector<int> p = {3,0,1,2,5,4};
+
+    EXPECT_EQ(vector<string>({"d","a","b","c","f","e"}), permuted(v, p));
+    EXPECT_EQ(vector<string>({"b","c","d","a","f","e"}), unpermuted(v, p));
+    EXPECT_EQ(v, unpermuted(permuted(v, p), p));
+
+    vector<string> w = v;
+    permute(w, p);
+    EXPECT_EQ(permuted(v, p), w);
+    unpermute(w, p);
+    EXPECT_EQ(v, w);
+    unpermute(w, p);
+    EXPECT_EQ(unpermuted(v, p), w);
+
+    size_t n = 100000;
+    vector<size_t> q(n), r(n);
+    for (size_t i = 0;i < n;i++) q[i] = (i*7919)%n;
+    for (size_t i = 0;i < n;i++) r[i] = i;
+
+    auto s = unpermuted(r, q);
+    for (size_t i = 0;i < n;i++) EXPECT_EQ(i, s[q[i]]);
+    permute(s, q);
+    EXPECT_EQ(r, s);
+}
+
+TEST(unit_algorithm, select_from)
+{
+    vector<string> v = {"a","b","c","d","e"};
+    vector<int> s = {4,2,7,2,0};
+
+    EXPECT_EQ(vector<string>({"b","e","a"}), select_from(v, s, vector<int>({2,0,4})));
+    EXPECT_EQ(vector<string>({"c","a"}), select_from(v, s, vector<int>({9,7,4})));
+
+    vector<int> match = {0,1,2,3,4,5,6,7,8,9,2,7};
+    vector<string> expected = {"e","b","a","c","b","c"};
+    EXPECT_EQ(expected, select_from(v, s, match));
+
+    select_index<vector<int>> index(s);
+    EXPECT_EQ(4u, index.size());
+    EXPECT_EQ(1u, index.find(2));
+    EXPECT_EQ(select_index<vector<int>>::npos, index.find(3));
+    EXPECT_EQ(expected, select_from(v, index, match));
+
+    vector<complex<double>> sc = {{1,1},{2,0},{1,1},{0,3}};
+    vector<int> vc = {10,20,30,40};
+    vector<complex<double>> mc(10, {0,3});
+    mc[4] = {1,1};
+    EXPECT_EQ(vector<int>({40,40,40,40,10,40,40,40,40,40}), select_from(vc, sc, mc));
+
+    vector<pair<int,int>> sp = {{1,2},{3,4},{1,2}};
+    vector<int> vp = {10,20,30};
+    vector<pair<int,int>> mp(9, {3,4});
+    mp[0] = {1,2};
+    mp[1] = {5,6};
+    EXPECT_EQ(vector<int>({10,20,20,20,20,20,20,20}), select_from(vp, sp, mp));
+}
+
+TEST(unit_algorithm, append)
+{
+    vector<int> v = {1,2};
+    vector<int> a = {3,4};
+    list<int> l = {5};
+    EXPECT_EQ(vector<int>({1,2,3,4,5,6,7}), append(v, a, l, vector<int>{6,7}));
+    EXPECT_EQ(vector<int>({3,4}), a);
+    EXPECT_EQ(vector<int>({3,4,1}), appended(a, set<int>{1}));
+    EXPECT_EQ(vector<int>({1,2,3,4,5,6,7}), appended(v));
+
+    vector<string> s = {"a"};
+    vector<string> t = {"b","c"};
+    append(s, t);
+    EXPECT_EQ(vector<string>({"a","b","c"}), s);
+    EXPECT_EQ(vector<string>({"b","c"}), t);
+    append(s, std::move(t), list<string>{"d"});
+    EXPECT_EQ(vector<string>({"a","b","c","b","c","d"}), s);
+    EXPECT_TRUE(t[0].empty() && t[1].empty());
+
+    list<double> ld = {1.0};
+    const vector<double> vd = {2.0, 3.0};
+    EXPECT_EQ(list<double>({1.0,2.0,3.0,2.0,3.0}), append(ld, vd, vd));
+
+    string str = "ab";
+    EXPECT_EQ("abcde", appended(str, string("cd"), vector<char>{'e'}));
+
+    vector<int> big;
+    for (int i = 0;i < 1000;i++) append(big, vector<int>{i});
+    EXPECT_EQ(1000u, big.size());
+    EXPECT_EQ(999, big.back());
 }
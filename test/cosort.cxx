@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -19,3 +23,247 @@ TEST(unit_cosort, cosort)
     EXPECT_EQ(vector<int>({9,8,6,4,4,4,1,1,0,-1}), k);
     EXPECT_EQ(vector<int>({8,1,3,0,6,7,2,9,4,5}), v);
 }
+
+TEST(unit_cosort, parallel_cosort)
+{
+    vector<int> k0(100000);
+    for (size_t i = 0;i < k0.size();i++) k0[i] = (i*7919)%1009;
+
+    vector<int> k = k0;
+    vector<int> v(k.size());
+    for (size_t i = 0;i < v.size();i++) v[i] = i;
+
+    cosort(par(4), k, v);
+    EXPECT_TRUE(is_sorted(k.begin(), k.end()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(k0[v[i]], k[i]);
+
+    cosort(par(3), k, v, greater<int>());
+    EXPECT_TRUE(is_sorted(k.begin(), k.end(), greater<int>()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(k0[v[i]], k[i]);
+
+    k = {4,8,1,6,0,-1,4,4,9,1};
+    v = {0,1,2,3,4,5,6,7,8,9};
+    cosort(par, k, v);
+    EXPECT_EQ(vector<int>({-1,0,1,1,4,4,4,6,8,9}), k);
+    EXPECT_EQ(vector<int>({5,4,2,9,0,6,7,3,1,8}), v);
+}
+
+TEST(unit_cosort, radix_cosort)
+{
+    vector<int> k0(5000);
+    for (size_t i = 0;i < k0.size();i++) k0[i] = int((i*7919)%1009)-500;
+
+    vector<int> k = k0;
+    vector<size_t> v(k.size());
+    for (size_t i = 0;i < v.size();i++) v[i] = i;
+
+    cosort(k, v);
+    EXPECT_TRUE(is_sorted(k.begin(), k.end()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(k0[v[i]], k[i]);
+    for (size_t i = 1;i < v.size();i++) if (k[i] == k[i-1]) { EXPECT_LT(v[i-1], v[i]); }
+
+    cosort(k, v, greater<int>());
+    EXPECT_TRUE(is_sorted(k.begin(), k.end(), greater<int>()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(k0[v[i]], k[i]);
+
+    vector<double> d0(5000);
+    for (size_t i = 0;i < d0.size();i++) d0[i] = (double((i*7919)%1009)-500.5)/7;
+    d0[10] = -0.0;
+    d0[20] = 0.0;
+    d0[30] = -1e300;
+    d0[40] = 1e-300;
+
+    vector<double> d = d0;
+    for (size_t i = 0;i < v.size();i++) v[i] = i;
+
+    cosort(d, v);
+    EXPECT_TRUE(is_sorted(d.begin(), d.end()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(d0[v[i]], d[i]);
+    EXPECT_EQ(-1e300, d[0]);
+
+    vector<uint64_t> u0(5000);
+    for (size_t i = 0;i < u0.size();i++) u0[i] = uint64_t(i*0x9e3779b97f4a7c15ull);
+
+    vector<uint64_t> u = u0;
+    vector<string> s(u.size());
+    for (size_t i = 0;i < s.size();i++) s[i] = to_string(i);
+
+    cosort(u, s, greater<uint64_t>());
+    EXPECT_TRUE(is_sorted(u.begin(), u.end(), greater<uint64_t>()));
+    for (size_t i = 0;i < s.size();i++) EXPECT_EQ(u0[stoul(s[i])], u[i]);
+}
+
+TEST(unit_cosort, indirect_cosort)
+{
+    struct heavy
+    {
+        int id;
+        double payload[40];
+    };
+
+    vector<int> k0(1000);
+    for (size_t i = 0;i < k0.size();i++) k0[i] = int((i*7919)%1009)-500;
+
+    vector<int> k = k0;
+    vector<heavy> v(k.size());
+    for (size_t i = 0;i < v.size();i++) v[i].id = i;
+
+    cosort(k, v, [](int a, int b) { return a < b; });
+    EXPECT_TRUE(is_sorted(k.begin(), k.end()));
+    for (size_t i = 0;i < v.size();i++) EXPECT_EQ(k0[v[i].id], k[i]);
+
+    k = k0;
+    vector<string> s(k.size());
+    for (size_t i = 0;i < s.size();i++) s[i] = to_string(i);
+
+    cosort(indirect, k, s, greater<int>());
+    EXPECT_TRUE(is_sorted(k.begin(), k.end(), greater<int>()));
+    for (size_t i = 0;i < s.size();i++) EXPECT_EQ(k0[stoi(s[i])], k[i]);
+
+    k = {4,8,1,6,0,-1,4,4,9,1};
+    vector<int> w = {0,1,2,3,4,5,6,7,8,9};
+    cosort(indirect, k, w);
+    EXPECT_EQ(vector<int>({-1,0,1,1,4,4,4,6,8,9}), k);
+    for (size_t i = 0;i < w.size();i++)
+        EXPECT_EQ(k[i], (vector<int>({4,8,1,6,0,-1,4,4,9,1})[w[i]]));
+}
+
+TEST(unit_cosort, apply_permutation)
+{
+    vector<string> v = {"a","b","c","d","e","f"};
+    vector<size_t> p = {3,0,1,2,5,4};
+    detail::apply_permutation(v.begin(), v.size(),
+                              [&p](size_t i) -> size_t& { return p[i]; });
+    EXPECT_EQ(vector<string>({"d","a","b","c","f","e"}), v);
+    EXPECT_EQ(vector<size_t>({0,1,2,3,4,5}), p);
+}
+
+TEST(unit_cosort, multi_cosort)
+{
+    vector<int> k = {4,8,1,6,0,-1,4,4,9,1};
+    vector<int> c1 = {0,1,2,3,4,5,6,7,8,9};
+    vector<string> c2 = {"0","1","2","3","4","5","6","7","8","9"};
+    vector<double> c3 = {0,10,20,30,40,50,60,70,80,90};
+
+    cosort(k, c1, c2, c3);
+    EXPECT_EQ(vector<int>({-1,0,1,1,4,4,4,6,8,9}), k);
+    EXPECT_EQ(vector<int>({5,4,2,9,0,6,7,3,1,8}), c1);
+    EXPECT_EQ(vector<string>({"5","4","2","9","0","6","7","3","1","8"}), c2);
+    EXPECT_EQ(vector<double>({50,40,20,90,0,60,70,30,10,80}), c3);
+
+    vector<string> s = {"d","b","a","c"};
+    vector<int> d1 = {3,1,0,2};
+    vector<string> d2 = {"3","1","0","2"};
+    cosort(s, d1, d2);
+    EXPECT_EQ(vector<string>({"a","b","c","d"}), s);
+    EXPECT_EQ(vector<int>({0,1,2,3}), d1);
+    EXPECT_EQ(vector<string>({"0","1","2","3"}), d2);
+
+    vector<string> l0(1000);
+    for (size_t i = 0;i < l0.size();i++) l0[i] = to_string((i*7919)%1009);
+    vector<string> l = l0;
+    vector<size_t> e1(l.size());
+    vector<string> e2(l.size());
+    for (size_t i = 0;i < l.size();i++) { e1[i] = i; e2[i] = l[i]; }
+
+    cosort(l, e1, e2);
+    EXPECT_TRUE(is_sorted(l.begin(), l.end()));
+    EXPECT_EQ(l, e2);
+    for (size_t i = 0;i < l.size();i++) EXPECT_EQ(l0[e1[i]], l[i]);
+
+    k = {4,8,1,6,0,-1,4,4,9,1};
+    c1 = {0,1,2,3,4,5,6,7,8,9};
+    c2 = {"0","1","2","3","4","5","6","7","8","9"};
+    cosort(k, c1, c2, std::greater<int>());
+    EXPECT_EQ(vector<int>({9,8,6,4,4,4,1,1,0,-1}), k);
+    for (size_t i = 0;i < k.size();i++) EXPECT_EQ(to_string(c1[i]), c2[i]);
+    sort(c1.begin()+3, c1.begin()+6);
+    sort(c1.begin()+6, c1.begin()+8);
+    EXPECT_EQ(vector<int>({8,1,3,0,6,7,2,9,4,5}), c1);
+
+    s = {"d","b","a","c"};
+    d1 = {3,1,0,2};
+    d2 = {"3","1","0","2"};
+    vector<double> d3 = {30,10,0,20};
+    cosort(s, d1, d2, d3, [](const string& a, const string& b) { return a > b; });
+    EXPECT_EQ(vector<string>({"d","c","b","a"}), s);
+    EXPECT_EQ(vector<int>({3,2,1,0}), d1);
+    EXPECT_EQ(vector<string>({"3","2","1","0"}), d2);
+    EXPECT_EQ(vector<double>({30,20,10,0}), d3);
+}
+
+TEST(unit_cosort, stable_cosort)
+{
+    vector<int> k = {4,8,1,6,0,-1,4,4,9,1};
+    vector<string> v = {"0","1","2","3","4","5","6","7","8","9"};
+
+    stable_cosort(k, v, [](int a, int b) { return a < b; });
+    EXPECT_EQ(vector<int>({-1,0,1,1,4,4,4,6,8,9}), k);
+    EXPECT_EQ(vector<string>({"5","4","2","9","0","6","7","3","1","8"}), v);
+
+    stable_cosort(k, v, [](int a, int b) { return a > b; });
+    EXPECT_EQ(vector<int>({9,8,6,4,4,4,1,1,0,-1}), k);
+    EXPECT_EQ(vector<string>({"8","1","3","0","6","7","2","9","4","5"}), v);
+
+    vector<int> l(5000);
+    vector<int> w(l.size());
+    for (size_t i = 0;i < l.size();i++) { l[i] = (i*7919)%13; w[i] = i; }
+
+    stable_cosort(l, w);
+    EXPECT_TRUE(is_sorted(l.begin(), l.end()));
+    for (size_t i = 1;i < l.size();i++) if (l[i] == l[i-1]) { EXPECT_LT(w[i-1], w[i]); }
+
+    vector<double> z(5000);
+    vector<int> zw(z.size());
+    for (size_t i = 0;i < z.size();i++)
+    {
+        z[i] = i%3 == 0 ? (i%2 ? -0.0 : 0.0) : double((i*7919)%13)-6;
+        zw[i] = i;
+    }
+
+    stable_cosort(z, zw);
+    EXPECT_TRUE(is_sorted(z.begin(), z.end()));
+    for (size_t i = 0;i < z.size();i++)
+    {
+        if (zw[i]%3 == 0) { EXPECT_EQ(zw[i]%2 == 1, signbit(z[i])); }
+    }
+    for (size_t i = 1;i < z.size();i++) if (z[i] == z[i-1]) { EXPECT_LT(zw[i-1], zw[i]); }
+}
+
+TEST(unit_cosort, partial_cosort)
+{
+    vector<int> k = {4,8,1,6,0,-1,4,4,9,1};
+    vector<int> v = {0,1,2,3,4,5,6,7,8,9};
+
+    partial_cosort(k, v, 3);
+    EXPECT_EQ(vector<int>({-1,0,1}), vector<int>(k.begin(), k.begin()+3));
+    EXPECT_EQ(vector<int>({5,4}), vector<int>(v.begin(), v.begin()+2));
+    EXPECT_TRUE(v[2] == 2 || v[2] == 9);
+    for (size_t i = 0;i < k.size();i++)
+        EXPECT_EQ(k[i], (vector<int>({4,8,1,6,0,-1,4,4,9,1})[v[i]]));
+
+    partial_cosort(k, v, 2, greater<int>());
+    EXPECT_EQ(vector<int>({9,8}), vector<int>(k.begin(), k.begin()+2));
+    EXPECT_EQ(vector<int>({8,1}), vector<int>(v.begin(), v.begin()+2));
+
+    partial_cosort(k, v, 100);
+    EXPECT_EQ(vector<int>({-1,0,1,1,4,4,4,6,8,9}), k);
+}
+
+TEST(unit_cosort, select_cosort)
+{
+    vector<int> k0 = {4,8,1,6,0,-1,4,4,9,1};
+    vector<int> k = k0;
+    vector<int> v = {0,1,2,3,4,5,6,7,8,9};
+
+    select_cosort(k, v, 7);
+    EXPECT_EQ(6, k[7]);
+    EXPECT_EQ(3, v[7]);
+    for (size_t i = 0;i < 7;i++) EXPECT_LE(k[i], 6);
+    for (size_t i = 8;i < k.size();i++) EXPECT_GE(k[i], 6);
+    for (size_t i = 0;i < k.size();i++) EXPECT_EQ(k[i], k0[v[i]]);
+
+    select_cosort(k, v, 0, greater<int>());
+    EXPECT_EQ(9, k[0]);
+    EXPECT_EQ(8, v[0]);
+}
@@ -0,0 +1,81 @@
+#include <list>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "view.hpp"
+
+using namespace std;
+using namespace stl_ext;
+
+TEST(unit_view, map)
+{
+    vector<int> v = {0,1,2,3,4};
+    auto m = view::map([](int x) { return x*x; }, v);
+    EXPECT_EQ(vector<int>({0,1,4,9,16}), view::collect(m));
+
+    v[2] = 5;
+    EXPECT_EQ(vector<int>({0,1,25,9,16}), view::collect(m));
+
+    vector<string> s;
+    for (auto x : view::map([](int x) { return to_string(x); }, list<int>{7,8}))
+        s.push_back(x);
+    EXPECT_EQ(vector<string>({"7","8"}), s);
+}
+
+TEST(unit_view, filter)
+{
+    vector<int> v = {0,1,2,3,4,5,6,7,8,9};
+    EXPECT_EQ(vector<int>({1,3,5,7,9}),
+              view::collect(view::filter(v, [](int x) { return x%2; })));
+    EXPECT_EQ(vector<int>(),
+              view::collect(view::filter(v, [](int x) { return x > 9; })));
+    EXPECT_EQ(vector<int>({0,1,2,4,5,6,7,8,9}), view::collect(view::erase(v, 3)));
+    EXPECT_EQ(vector<int>({5,6,7,8,9}),
+              view::collect(view::erase(v, [](int x) { return x < 5; })));
+
+    int calls = 0;
+    auto f = view::filter(v, [&](int x) { calls++; return x > 7; });
+    EXPECT_EQ(0, calls);
+    EXPECT_EQ(8, *f.begin());
+    EXPECT_EQ(9, calls);
+}
+
+TEST(unit_view, zip)
+{
+    vector<int> a = {1,2,3};
+    list<string> b = {"a","b","c","d"};
+
+    EXPECT_EQ((vector<tuple<int,string>>{make_tuple(1,"a"), make_tuple(2,"b"),
+                                         make_tuple(3,"c")}),
+              view::collect(view::zip(a, b)));
+
+    for (auto t : view::zip(a, vector<int>{10,20,30})) get<0>(t) += get<1>(t);
+    EXPECT_EQ(vector<int>({11,22,33}), a);
+}
+
+TEST(unit_view, pipeline)
+{
+    vector<int> v(1000);
+    for (int i = 0;i < 1000;i++) v[i] = i;
+
+    int mapped = 0;
+    auto w = view::collect(
+        view::map([&](int x) { mapped++; return x/2.0; },
+            view::erase(
+                view::filter(v, [](int x) { return x%3 == 0; }),
+            [](int x) { return x%2 == 0; })));
+
+    vector<double> expected;
+    for (int i = 0;i < 1000;i++) if (i%3 == 0 && i%2 != 0) expected.push_back(i/2.0);
+    EXPECT_EQ(expected, w);
+    EXPECT_EQ(int(expected.size()), mapped);
+    EXPECT_EQ(expected.size(), w.size());
+
+    auto sums = view::collect<list<int>>(
+        view::map([](tuple<int&,const int&> t) { return get<0>(t)+get<1>(t); },
+                  view::zip(v, view::collect(view::map([](int x) { return -x; }, v)))));
+    EXPECT_EQ(list<int>(1000, 0), sums);
+}